@@ -12,19 +12,23 @@ class xy_rect : public hittable {
 public:
     xy_rect() {}
 
-    xy_rect(double _x0, double _x1, double _y0, double _y1, double _k, shared_ptr<material> mat) :
+    xy_rect(real _x0, real _x1, real _y0, real _y1, real _k, shared_ptr<material> mat) :
             x0(_x0), x1(_x1), y0(_y0), y1(_y1), k(_k), mp(mat) {};
 
-    virtual bool hit(const Ray &r, double t_min, double t_max, hit_record &rec) const override;
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override;
 
-    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override {
-        output_box = aabb(Point3(x0, y0, k - 0.0001), Point3(x1, y1, k + 0.0001));
+    virtual bool intersect(const Ray &r, real t_min, real t_max, real &t) const override;
+
+    void surface_interaction(const Ray &r, real t, hit_record &rec) const;
+
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override {
+        output_box = aabb(Point3(x0, y0, k), Point3(x1, y1, k)).padded();
         return true;
     }
 
-    virtual double pdf_value(const Point3 &origin, const Vec3 &v) const override {
+    virtual real pdf_value(const Point3 &origin, const Vec3 &v) const override {
         hit_record rec;
-        if (!this->hit(Ray(origin, v), 0.001, infinity, rec)) {
+        if (!this->hit(Ray(origin, v), 0, infinity, rec)) {
             return 0;
         }
 
@@ -36,35 +40,50 @@ public:
     }
 
     virtual Vec3 random(const Point3 &origin) const override {
-        auto random_point = Point3(random_double(x0, x1), k, random_double(y0, y1));
+        auto random_point = Point3(random_double(x0, x1), random_double(y0, y1), k);
         return random_point - origin;
     }
 
+    // 法线锥只有一个方向 (外法线)，发光的半角为 π/2
+    virtual bool emitter_bounds(real time0, real time1, light_bounds &out) const override {
+        out.bounds = aabb(Point3(x0, y0, k), Point3(x1, y1, k)).padded();
+        out.w = Vec3(0, 0, 1);
+        out.phi = (x1 - x0) * (y1 - y0);
+        out.cos_theta_o = 1;
+        out.cos_theta_e = 0;
+        out.two_sided = true;
+        return true;
+    }
+
 public:
     shared_ptr<material> mp;
-    double x0, x1, y0, y1, k;
+    real x0, x1, y0, y1, k;
 };
 
 class xz_rect : public hittable {
 public:
     xz_rect() {}
 
-    xz_rect(double _x0, double _x1, double _z0, double _z1, double _k,
+    xz_rect(real _x0, real _x1, real _z0, real _z1, real _k,
             shared_ptr<material> mat)
             : x0(_x0), x1(_x1), z0(_z0), z1(_z1), k(_k), mp(mat) {};
 
-    virtual bool hit(const Ray &r, double t_min, double t_max, hit_record &rec) const override;
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override;
+
+    virtual bool intersect(const Ray &r, real t_min, real t_max, real &t) const override;
 
-    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override {
+    void surface_interaction(const Ray &r, real t, hit_record &rec) const;
+
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override {
         // The bounding box must have non-zero width in each dimension, so pad the Y
         // dimension a small amount.
-        output_box = aabb(Point3(x0, k - 0.0001, z0), Point3(x1, k + 0.0001, z1));
+        output_box = aabb(Point3(x0, k, z0), Point3(x1, k, z1)).padded();
         return true;
     }
 
-    virtual double pdf_value(const Point3 &origin, const Vec3 &v) const override {
+    virtual real pdf_value(const Point3 &origin, const Vec3 &v) const override {
         hit_record rec;
-        if (!this->hit(Ray(origin, v), 0.001, infinity, rec)) {
+        if (!this->hit(Ray(origin, v), 0, infinity, rec)) {
             return 0;
         }
 
@@ -80,31 +99,45 @@ public:
         return random_point - origin;
     }
 
+    virtual bool emitter_bounds(real time0, real time1, light_bounds &out) const override {
+        out.bounds = aabb(Point3(x0, k, z0), Point3(x1, k, z1)).padded();
+        out.w = Vec3(0, 1, 0);
+        out.phi = (x1 - x0) * (z1 - z0);
+        out.cos_theta_o = 1;
+        out.cos_theta_e = 0;
+        out.two_sided = true;
+        return true;
+    }
+
 public:
     shared_ptr<material> mp;
-    double x0, x1, z0, z1, k;
+    real x0, x1, z0, z1, k;
 };
 
 class yz_rect : public hittable {
 public:
     yz_rect() {}
 
-    yz_rect(double _y0, double _y1, double _z0, double _z1, double _k,
+    yz_rect(real _y0, real _y1, real _z0, real _z1, real _k,
             shared_ptr<material> mat)
             : y0(_y0), y1(_y1), z0(_z0), z1(_z1), k(_k), mp(mat) {};
 
-    virtual bool hit(const Ray &r, double t_min, double t_max, hit_record &rec) const override;
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override;
+
+    virtual bool intersect(const Ray &r, real t_min, real t_max, real &t) const override;
 
-    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override {
+    void surface_interaction(const Ray &r, real t, hit_record &rec) const;
+
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override {
         // The bounding box must have non-zero width in each dimension, so pad the X
         // dimension a small amount.
-        output_box = aabb(Point3(k - 0.0001, y0, z0), Point3(k + 0.0001, y1, z1));
+        output_box = aabb(Point3(k, y0, z0), Point3(k, y1, z1)).padded();
         return true;
     }
 
-    virtual double pdf_value(const Point3 &origin, const Vec3 &v) const override {
+    virtual real pdf_value(const Point3 &origin, const Vec3 &v) const override {
         hit_record rec;
-        if (!this->hit(Ray(origin, v), 0.001, infinity, rec)) {
+        if (!this->hit(Ray(origin, v), 0, infinity, rec)) {
             return 0;
         }
 
@@ -116,72 +149,113 @@ public:
     }
 
     virtual Vec3 random(const Point3 &origin) const override {
-        auto random_point = Point3(random_double(y0, y1), k, random_double(z0, z1));
+        auto random_point = Point3(k, random_double(y0, y1), random_double(z0, z1));
         return random_point - origin;
     }
 
+    virtual bool emitter_bounds(real time0, real time1, light_bounds &out) const override {
+        out.bounds = aabb(Point3(k, y0, z0), Point3(k, y1, z1)).padded();
+        out.w = Vec3(1, 0, 0);
+        out.phi = (y1 - y0) * (z1 - z0);
+        out.cos_theta_o = 1;
+        out.cos_theta_e = 0;
+        out.two_sided = true;
+        return true;
+    }
+
 public:
     shared_ptr<material> mp;
-    double y0, y1, z0, z1, k;
+    real y0, y1, z0, z1, k;
 };
 
-bool xy_rect::hit(const Ray &r, double t_min, double t_max, hit_record &rec) const {
-    auto t = (k - r.origin().z()) / r.direction().z();
-    if (t < t_min || t > t_max) {
+bool xy_rect::intersect(const Ray &r, real t_min, real t_max, real &t) const {
+    t = (k - r.origin().z()) / r.direction().z();
+    // 射线与平面平行时 t 为 inf 或 NaN，写成取反的形式让 NaN 也被拒绝
+    if (!(t >= t_min && t <= t_max))
         return false;
-    }
 
     auto x = r.origin().x() + t * r.direction().x();
     auto y = r.origin().y() + t * r.direction().y();
-    if (x < x0 || x > x1 || y < y0 || y > y1) {
-        return false;
-    }
+    return x >= x0 && x <= x1 && y >= y0 && y <= y1;
+}
 
+void xy_rect::surface_interaction(const Ray &r, real t, hit_record &rec) const {
+    auto x = r.origin().x() + t * r.direction().x();
+    auto y = r.origin().y() + t * r.direction().y();
     rec.u = (x - x0) / (x1 - x0);
     rec.v = (y - y0) / (y1 - y0);
     rec.t = t;
-
     auto outward_normal = Vec3(0, 0, 1);
     rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mp;
+    rec.mat_ptr = mp.get();
     rec.p = r.at(t);
+}
 
+bool xy_rect::hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
+    real t;
+    if (!intersect(r, t_min, t_max, t))
+        return false;
+    surface_interaction(r, t, rec);
     return true;
 }
 
-bool xz_rect::hit(const Ray &r, double t_min, double t_max, hit_record &rec) const {
-    auto t = (k - r.origin().y()) / r.direction().y();
-    if (t < t_min || t > t_max)
+bool xz_rect::intersect(const Ray &r, real t_min, real t_max, real &t) const {
+    t = (k - r.origin().y()) / r.direction().y();
+    if (!(t >= t_min && t <= t_max))
         return false;
+
+    auto x = r.origin().x() + t * r.direction().x();
+    auto z = r.origin().z() + t * r.direction().z();
+    return x >= x0 && x <= x1 && z >= z0 && z <= z1;
+}
+
+void xz_rect::surface_interaction(const Ray &r, real t, hit_record &rec) const {
     auto x = r.origin().x() + t * r.direction().x();
     auto z = r.origin().z() + t * r.direction().z();
-    if (x < x0 || x > x1 || z < z0 || z > z1)
-        return false;
     rec.u = (x - x0) / (x1 - x0);
     rec.v = (z - z0) / (z1 - z0);
     rec.t = t;
     auto outward_normal = Vec3(0, 1, 0);
     rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mp;
+    rec.mat_ptr = mp.get();
     rec.p = r.at(t);
+}
+
+bool xz_rect::hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
+    real t;
+    if (!intersect(r, t_min, t_max, t))
+        return false;
+    surface_interaction(r, t, rec);
     return true;
 }
 
-bool yz_rect::hit(const Ray &r, double t_min, double t_max, hit_record &rec) const {
-    auto t = (k - r.origin().x()) / r.direction().x();
-    if (t < t_min || t > t_max)
+bool yz_rect::intersect(const Ray &r, real t_min, real t_max, real &t) const {
+    t = (k - r.origin().x()) / r.direction().x();
+    if (!(t >= t_min && t <= t_max))
         return false;
+
+    auto y = r.origin().y() + t * r.direction().y();
+    auto z = r.origin().z() + t * r.direction().z();
+    return y >= y0 && y <= y1 && z >= z0 && z <= z1;
+}
+
+void yz_rect::surface_interaction(const Ray &r, real t, hit_record &rec) const {
     auto y = r.origin().y() + t * r.direction().y();
     auto z = r.origin().z() + t * r.direction().z();
-    if (y < y0 || y > y1 || z < z0 || z > z1)
-        return false;
     rec.u = (y - y0) / (y1 - y0);
     rec.v = (z - z0) / (z1 - z0);
     rec.t = t;
     auto outward_normal = Vec3(1, 0, 0);
     rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mp;
+    rec.mat_ptr = mp.get();
     rec.p = r.at(t);
+}
+
+bool yz_rect::hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
+    real t;
+    if (!intersect(r, t_min, t_max, t))
+        return false;
+    surface_interaction(r, t, rec);
     return true;
 }
 
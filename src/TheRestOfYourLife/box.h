@@ -7,45 +7,194 @@
 
 #include "rtweekend.h"
 
-#include "aarect.h"
-#include "hittable_list.h"
+#include "hittable.h"
 
+// 轴对齐的立方体。求交只做一次 slab 测试，法线和 uv 由命中的轴决定：
+// 与 aarect 一致，x 面 (yz) 的 uv 为 (y, z)，y 面 (xz) 为 (x, z)，z 面 (xy) 为 (x, y)。
+// 法线朝外，从内部射出时 front_face 为 false。
 class box : public hittable {
 public:
     box() {}
 
-    box(const Point3 &p0, const Point3 &p1, shared_ptr<material> ptr);
+    box(const Point3 &p0, const Point3 &p1, shared_ptr<material> ptr) : box_min(p0), box_max(p1), mat_ptr(ptr) {}
 
-    virtual bool hit(const Ray &r, double t_min, double t_max, hit_record &rec) const override;
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override;
 
-    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override {
-        output_box = aabb(box_min, box_max);
+    virtual bool intersect(const Ray &r, real t_min, real t_max, real &t) const override;
+
+    virtual bool interval(const Ray &r, real t_min, real t_max, real &t_enter, real &t_exit) const override;
+
+    void surface_interaction(const Ray &r, real t, hit_record &rec) const;
+
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override {
+        output_box = aabb(box_min, box_max).padded();
         return true;
     }
 
+    virtual real pdf_value(const Point3 &o, const Vec3 &v) const override;
+
+    virtual Vec3 random(const Point3 &o) const override;
+
 public:
     Point3 box_min;
     Point3 box_max;
-    hittable_list sides;
+    shared_ptr<material> mat_ptr;
+
+private:
+    // 射线进入、离开立方体的距离和对应的轴，不相交时返回 false
+    bool slab(const Ray &r, real &t_near, real &t_far, int &near_axis, int &far_axis) const;
+
+    // 垂直于 axis 的面的面积
+    real face_area(int axis) const {
+        auto d = box_max - box_min;
+        return d[(axis + 1) % 3] * d[(axis + 2) % 3];
+    }
+
+    // 从 o 能看到的面：o 在某个轴的下界之外时能看到下方的面，上界之外时能看到上方的面，
+    // o 在立方体内部时所有面都可见。visible[axis][0 / 1] 对应下 / 上方的面，返回可见面的总面积
+    real visible_faces(const Point3 &o, bool visible[3][2]) const;
 };
 
-box::box(const Point3 &p0, const Point3 &p1, shared_ptr<material> ptr) {
-    box_min = p0;
-    box_max = p1;
+bool box::slab(const Ray &r, real &t_near, real &t_far, int &near_axis, int &far_axis) const {
+    real t0[3], t1[3];
+    for (int a = 0; a < 3; a++) {
+        t0[a] = ((r.sign[a] ? box_max : box_min)[a] - r.orig[a]) * r.inv_dir[a];
+        t1[a] = ((r.sign[a] ? box_min : box_max)[a] - r.orig[a]) * r.inv_dir[a];
+    }
+
+    // 与 aabb::hit 相同，NaN (方向分量为 0 且起点在面上) 不收缩区间；
+    // 用条件选择代替分支，命中的轴对随机方向的射线来说不可预测
+    t_near = -infinity;
+    t_far = infinity;
+    near_axis = far_axis = 0;
+    for (int a = 0; a < 3; a++) {
+        const bool closer_near = t0[a] > t_near;
+        const bool closer_far = t1[a] < t_far;
+        t_near = closer_near ? t0[a] : t_near;
+        near_axis = closer_near ? a : near_axis;
+        t_far = closer_far ? t1[a] : t_far;
+        far_axis = closer_far ? a : far_axis;
+    }
+
+    return t_near <= t_far;
+}
+
+bool box::intersect(const Ray &r, real t_min, real t_max, real &t) const {
+    // 遍历阶段只需要进入、离开的距离，不需要轴
+    real t_near = -infinity, t_far = infinity;
+    for (int a = 0; a < 3; a++) {
+        auto t0 = ((r.sign[a] ? box_max : box_min)[a] - r.orig[a]) * r.inv_dir[a];
+        auto t1 = ((r.sign[a] ? box_min : box_max)[a] - r.orig[a]) * r.inv_dir[a];
+        t_near = t0 > t_near ? t0 : t_near;
+        t_far = t1 < t_far ? t1 : t_far;
+    }
+
+    // 先取进入点，起点在立方体内部时取离开点
+    t = t_near >= t_min ? t_near : t_far;
+    return t_near <= t_far && t >= t_min && t <= t_max;
+}
+
+bool box::interval(const Ray &r, real t_min, real t_max, real &t_enter, real &t_exit) const {
+    // slab 的进入、离开距离就是立方体内部的区间
+    t_enter = t_min;
+    t_exit = t_max;
+    for (int a = 0; a < 3; a++) {
+        auto t0 = ((r.sign[a] ? box_max : box_min)[a] - r.orig[a]) * r.inv_dir[a];
+        auto t1 = ((r.sign[a] ? box_min : box_max)[a] - r.orig[a]) * r.inv_dir[a];
+        t_enter = t0 > t_enter ? t0 : t_enter;
+        t_exit = t1 < t_exit ? t1 : t_exit;
+    }
+    return t_enter < t_exit;
+}
+
+void box::surface_interaction(const Ray &r, real t, hit_record &rec) const {
+    real t_near, t_far;
+    int near_axis, far_axis;
+    slab(r, t_near, t_far, near_axis, far_axis);
+
+    // 进入面是射线先遇到的一侧，离开面是另一侧
+    const bool entering = t == t_near;
+    const int axis = entering ? near_axis : far_axis;
+    const bool upper = entering ? r.sign[axis] : !r.sign[axis];
+
+    rec.t = t;
+    rec.p = r.at(t);
+    rec.p[axis] = upper ? box_max[axis] : box_min[axis];     // 交点精确落在面上
+
+    const int u_axis = axis == 0 ? 1 : 0;
+    const int v_axis = axis == 2 ? 1 : 2;
+    rec.u = (rec.p[u_axis] - box_min[u_axis]) / (box_max[u_axis] - box_min[u_axis]);
+    rec.v = (rec.p[v_axis] - box_min[v_axis]) / (box_max[v_axis] - box_min[v_axis]);
+
+    Vec3 outward_normal(0, 0, 0);
+    outward_normal[axis] = upper ? 1 : -1;
+    rec.set_face_normal(r, outward_normal);
+    rec.mat_ptr = mat_ptr.get();
+}
 
-    sides.add(make_shared<xy_rect>(p0.x(), p1.x(), p0.y(), p1.y(), p1.z(), ptr));
-    sides.add(make_shared<xy_rect>(p0.x(), p1.x(), p0.y(), p1.y(), p0.z(), ptr));
+bool box::hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
+    real t;
+    if (!intersect(r, t_min, t_max, t))
+        return false;
+    surface_interaction(r, t, rec);
+    return true;
+}
 
-    sides.add(make_shared<xz_rect>(p0.x(), p1.x(), p0.z(), p1.z(), p1.y(), ptr));
-    sides.add(make_shared<xz_rect>(p0.x(), p1.x(), p0.z(), p1.z(), p0.y(), ptr));
+real box::visible_faces(const Point3 &o, bool visible[3][2]) const {
+    const bool inside = o.x() >= box_min.x() && o.x() <= box_max.x()
+                        && o.y() >= box_min.y() && o.y() <= box_max.y()
+                        && o.z() >= box_min.z() && o.z() <= box_max.z();
 
-    sides.add(make_shared<yz_rect>(p0.y(), p1.y(), p0.z(), p1.z(), p1.x(), ptr));
-    sides.add(make_shared<yz_rect>(p0.y(), p1.y(), p0.z(), p1.z(), p0.x(), ptr));
+    real area = 0;
+    for (int a = 0; a < 3; a++) {
+        visible[a][0] = inside || o[a] < box_min[a];
+        visible[a][1] = inside || o[a] > box_max[a];
+        area += (visible[a][0] + visible[a][1]) * face_area(a);
+    }
+    return area;
 }
 
-bool box::hit(const Ray &r, double t_min, double t_max, hit_record &rec) const {
-    return sides.hit(r, t_min, t_max, rec);
+// 在从 o 可见的面上按面积均匀采样。对凸的立方体，每个方向最多击中一个可见面 (从内部看是离开面)，
+// 所以立体角密度就是这个面上的面积密度换算过来：距离^2 / (cos * 可见面积)
+real box::pdf_value(const Point3 &o, const Vec3 &v) const {
+    hit_record rec;
+    if (!this->hit(Ray(o, v), 0, infinity, rec))
+        return 0;
+
+    bool visible[3][2];
+    auto area = visible_faces(o, visible);
+    if (area <= 0)
+        return 0;
+
+    auto distance_squared = rec.t * rec.t * v.length_squared();
+    auto cosine = fabs(dot(v, rec.normal) / v.length());
+    return distance_squared / (cosine * area);
 }
 
+Vec3 box::random(const Point3 &o) const {
+    bool visible[3][2];
+    auto area = visible_faces(o, visible);
+
+    // 按面积选一个可见面，面的编号 face = 2 * axis + side
+    auto pick = random_double(0, area);
+    int face = 0;
+    for (int f = 0; f < 6; f++) {
+        if (!visible[f / 2][f % 2])
+            continue;
+        face = f;
+        pick -= face_area(f / 2);
+        if (pick < 0)
+            break;
+    }
+    const int axis = face / 2;
+    const int side = face % 2;
+
+    Point3 p;
+    for (int a = 0; a < 3; a++)
+        p[a] = random_double(box_min[a], box_max[a]);
+    p[axis] = side ? box_max[axis] : box_min[axis];
+
+    return p - o;
+}
 
 #endif //RAY_TRACING_BOX_H
@@ -11,20 +11,24 @@
 #include "hittable_list.h"
 
 #include <algorithm>
+#include <cstdint>
+#include <numeric>
 
 class bvh_node : public hittable {
 public:
     bvh_node();
 
-    bvh_node(const hittable_list &list, double time0, double time1) :
+    bvh_node(const hittable_list &list, real time0, real time1) :
             bvh_node(list.objects, 0, list.objects.size(), time0, time1) {}
 
     bvh_node(const std::vector<shared_ptr<hittable>> &src_objects,
-             size_t start, size_t end, double time0, double time1);
+             size_t start, size_t end, real time0, real time1);
 
-    virtual bool hit(const Ray &r, double t_min, double t_max, hit_record &rec) const override;
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override;
 
-    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override;
+    virtual bool intersect(const Ray &r, real t_min, real t_max, real &t) const override;
+
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override;
 
 public:
     shared_ptr<hittable> left;
@@ -32,7 +36,7 @@ public:
     aabb box;
 };
 
-inline bool box_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b, int axis) {
+inline bool box_compare(const shared_ptr<hittable> &a, const shared_ptr<hittable> &b, int axis) {
     aabb box_a;
     aabb box_b;
 
@@ -42,23 +46,25 @@ inline bool box_compare(const shared_ptr<hittable> a, const shared_ptr<hittable>
     return box_a.min().e[axis] < box_b.min().e[axis];
 }
 
-bool box_x_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
+bool box_x_compare(const shared_ptr<hittable> &a, const shared_ptr<hittable> &b) {
     return box_compare(a, b, 0);
 }
 
-bool box_y_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
+bool box_y_compare(const shared_ptr<hittable> &a, const shared_ptr<hittable> &b) {
     return box_compare(a, b, 1);
 }
 
-bool box_z_compare(const shared_ptr<hittable> a, const shared_ptr<hittable> b) {
+bool box_z_compare(const shared_ptr<hittable> &a, const shared_ptr<hittable> &b) {
     return box_compare(a, b, 2);
 }
 
 bvh_node::bvh_node(const std::vector<shared_ptr<hittable>> &src_objects,
-                   size_t start, size_t end, double time0, double time1) {
+                   size_t start, size_t end, real time0, real time1) {
 
-    // 上个节点中的所有物体
-    std::vector<shared_ptr<hittable>> objects = src_objects;
+    // 只复制本节点范围内的物体，整棵树的复制量是 O(n log n) 而不是每个节点都复制整个列表
+    std::vector<shared_ptr<hittable>> objects(src_objects.begin() + start, src_objects.begin() + end);
+    start = 0;
+    end = objects.size();
 
     // 在 x, y, z 中随机选一个轴
     int axis = random_int(0, 2);
@@ -89,8 +95,8 @@ bvh_node::bvh_node(const std::vector<shared_ptr<hittable>> &src_objects,
 
         // 对半分
         auto mid = start + object_span / 2;
-        left = make_shared<bvh_node>(objects, start, mid, time0, time1);
-        right = make_shared<bvh_node>(objects, mid, end, time0, time1);
+        left = arena_make_shared<bvh_node>(objects, start, mid, time0, time1);
+        right = arena_make_shared<bvh_node>(objects, mid, end, time0, time1);
     }
 
     aabb box_left, box_right;
@@ -103,7 +109,7 @@ bvh_node::bvh_node(const std::vector<shared_ptr<hittable>> &src_objects,
 }
 
 // 检查这个子节点是否被击中
-bool bvh_node::hit(const Ray &r, double t_min, double t_max, hit_record &rec) const {
+bool bvh_node::hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
     if (!box.hit(r, t_min, t_max))
         return false;
 
@@ -113,9 +119,228 @@ bool bvh_node::hit(const Ray &r, double t_min, double t_max, hit_record &rec) co
     return hit_left || hit_right;
 }
 
-bool bvh_node::bounding_box(double time0, double time1, aabb &output_box) const {
+bool bvh_node::intersect(const Ray &r, real t_min, real t_max, real &t) const {
+    if (!box.hit(r, t_min, t_max))
+        return false;
+
+    // 未命中的子节点可能改写 t，分开保存
+    real t_left, t_right;
+    bool hit_left = left->intersect(r, t_min, t_max, t_left);
+    bool hit_right = right->intersect(r, t_min, hit_left ? t_left : t_max, t_right);
+
+    if (hit_right)
+        t = t_right;
+    else if (hit_left)
+        t = t_left;
+    return hit_left || hit_right;
+}
+
+bool bvh_node::bounding_box(real time0, real time1, aabb &output_box) const {
     output_box = box;
     return true;
 }
 
+// 线性化的 BVH：节点按深度优先顺序存放在一个数组里，叶子保存一段连续的图元范围。
+// 只负责空间划分，图元本身由使用者保存，求交时把叶子范围交给回调函数，
+// 这样 scene 可以按类型分发，sphere_set / 网格等图元集合也可以直接按叶子范围批量求交。
+struct flat_bvh_node {
+    aabb box;
+    uint32_t offset;    // 叶子：第一个图元在 indices 中的位置；内部节点：右子节点的下标 (左子节点紧随其后)
+    uint16_t count;     // 叶子中的图元数量，0 表示内部节点
+    uint8_t axis;       // 内部节点的划分轴，用于按射线方向决定先访问哪个子节点
+};
+
+class flat_bvh {
+public:
+    flat_bvh() = default;
+
+    // 对图元包围盒建树，每个叶子最多 max_leaf_size 个图元。
+    // 叶子按 batch_width 个图元一批求交时 (SIMD)，SAH 按批数而不是图元数计算叶子代价，叶子会更满
+    void build(const std::vector<aabb> &bounds, int max_leaf_size = 8, int batch_width = 1) {
+        build(bounds.size(), [&](uint32_t i) -> const aabb & { return bounds[i]; }, max_leaf_size, batch_width);
+    }
+
+    // 同上，第 i 个图元的包围盒由 bounds_of(i) 即时计算，不需要先存下所有包围盒 (上亿个图元时每个 48 字节)
+    template<typename BoundsFn>
+    void build(size_t count, const BoundsFn &bounds_of, int max_leaf_size = 8, int batch_width = 1);
+
+    aabb bounding_box() const { return nodes.empty() ? aabb::empty() : nodes[0].box; }
+
+    // 遍历与射线相交的叶子，hit_leaf(first, count, t_max) 对 indices[first, first + count) 求交，
+    // 命中时返回 true 并把 t_max 缩短到最近交点
+    template<typename LeafFn>
+    bool traverse(const Ray &r, real t_min, real t_max, LeafFn &&hit_leaf) const;
+
+public:
+    std::vector<flat_bvh_node> nodes;
+    std::vector<uint32_t> indices;      // 叶子顺序下的图元编号
+
+    // 遍历栈的大小。建树保证深度不超过它：第 median_split_depth 层以下不再做 SAH，只按中位数对半分，
+    // 剩下的图元 (不超过 2^32 个) 最多再分 32 层。分布很偏的点云每层只剥掉几个离群点时也不会溢出
+    static const int traversal_stack_size = 128;
+    static const int median_split_depth = traversal_stack_size - 32;
+
+private:
+    uint32_t leaf_batch = 1;
+
+    template<typename BoundsFn>
+    uint32_t build_recursive(const BoundsFn &bounds_of, uint32_t start, uint32_t end, int max_leaf_size, int depth);
+
+    // n 个图元按批求交的批数，SAH 的图元代价
+    uint32_t batches(uint32_t n) const { return (n + leaf_batch - 1) / leaf_batch; }
+
+    uint32_t make_leaf(const aabb &box, uint32_t start, uint32_t end) {
+        nodes.push_back({box, start, static_cast<uint16_t>(end - start), 0});
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+};
+
+template<typename BoundsFn>
+void flat_bvh::build(size_t count, const BoundsFn &bounds_of, int max_leaf_size, int batch_width) {
+    nodes.clear();
+    leaf_batch = std::max(1, batch_width);
+    indices.resize(count);
+    std::iota(indices.begin(), indices.end(), 0u);
+
+    if (count == 0)
+        return;
+
+    nodes.reserve(2 * count / std::max(1, max_leaf_size / 2) + 1);
+    build_recursive(bounds_of, 0, static_cast<uint32_t>(count), std::max(1, std::min(max_leaf_size, 65535)), 0);
+
+    // 预留的容量多出 1/4 以上才收缩：收缩要复制整个数组，上亿个图元时峰值内存会多出一份节点
+    if (nodes.capacity() - nodes.size() > nodes.size() / 4)
+        nodes.shrink_to_fit();
+}
+
+template<typename BoundsFn>
+uint32_t flat_bvh::build_recursive(const BoundsFn &bounds_of, uint32_t start, uint32_t end, int max_leaf_size, int depth) {
+    aabb box = aabb::empty();
+    aabb centroid_box = aabb::empty();
+    for (auto i = start; i < end; i++) {
+        const aabb &b = bounds_of(indices[i]);
+        box = surrounding_box(box, b);
+        auto c = b.center();
+        centroid_box = surrounding_box(centroid_box, aabb(c, c));
+    }
+
+    const auto count = end - start;
+    if (count <= 1)
+        return make_leaf(box, start, end);
+
+    // 选择质心分布最长的轴
+    auto extent = centroid_box.max() - centroid_box.min();
+    int axis = 0;
+    if (extent.y() > extent[axis]) axis = 1;
+    if (extent.z() > extent[axis]) axis = 2;
+
+    uint32_t mid = start;
+    if (extent[axis] > 0 && depth < median_split_depth) {
+        // 分桶 SAH：把质心分到 bin_count 个桶里，选择代价最小的划分位置
+        const int bin_count = 12;
+        aabb bin_box[bin_count];
+        uint32_t bin_size[bin_count] = {};
+        for (auto &b: bin_box) b = aabb::empty();
+
+        auto bin_of = [&](uint32_t item) {
+            auto c = bounds_of(item).center()[axis];
+            auto b = static_cast<int>(bin_count * (c - centroid_box.min()[axis]) / extent[axis]);
+            return std::min(std::max(b, 0), bin_count - 1);
+        };
+
+        for (auto i = start; i < end; i++) {
+            auto b = bin_of(indices[i]);
+            bin_size[b]++;
+            bin_box[b] = surrounding_box(bin_box[b], bounds_of(indices[i]));
+        }
+
+        // 从右往左累计右侧的面积 x 数量
+        real right_cost[bin_count];
+        aabb acc = aabb::empty();
+        uint32_t acc_size = 0;
+        for (int b = bin_count - 1; b > 0; b--) {
+            acc = surrounding_box(acc, bin_box[b]);
+            acc_size += bin_size[b];
+            right_cost[b] = acc_size ? batches(acc_size) * acc.surface_area() : 0;
+        }
+
+        int best_split = -1;
+        real best_cost = infinity;
+        acc = aabb::empty();
+        acc_size = 0;
+        for (int b = 0; b < bin_count - 1; b++) {
+            acc = surrounding_box(acc, bin_box[b]);
+            acc_size += bin_size[b];
+            auto cost = (acc_size ? batches(acc_size) * acc.surface_area() : 0) + right_cost[b + 1];
+            if (acc_size > 0 && acc_size < count && cost < best_cost) {
+                best_cost = cost;
+                best_split = b;
+            }
+        }
+
+        // 图元足够少且不划分更便宜时直接做成叶子 (划分还要多付一次节点包围盒测试，代价按一个图元计)
+        if (count <= static_cast<uint32_t>(max_leaf_size) && batches(count) * box.surface_area() <= box.surface_area() + best_cost)
+            return make_leaf(box, start, end);
+
+        if (best_split >= 0) {
+            auto it = std::partition(indices.begin() + start, indices.begin() + end,
+                                     [&](uint32_t item) { return bin_of(item) <= best_split; });
+            mid = static_cast<uint32_t>(it - indices.begin());
+        }
+    } else if (count <= static_cast<uint32_t>(max_leaf_size)) {
+        return make_leaf(box, start, end);
+    }
+
+    // 所有质心重合、分桶失败或者树已经很深时按中位数对半分
+    if (mid == start || mid == end) {
+        mid = start + count / 2;
+        std::nth_element(indices.begin() + start, indices.begin() + mid, indices.begin() + end,
+                         [&](uint32_t a, uint32_t b) {
+                             return bounds_of(a).center()[axis] < bounds_of(b).center()[axis];
+                         });
+    }
+
+    auto node = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({box, 0, 0, static_cast<uint8_t>(axis)});
+    build_recursive(bounds_of, start, mid, max_leaf_size, depth + 1);
+    auto right = build_recursive(bounds_of, mid, end, max_leaf_size, depth + 1);
+    nodes[node].offset = right;
+    return node;
+}
+
+template<typename LeafFn>
+bool flat_bvh::traverse(const Ray &r, real t_min, real t_max, LeafFn &&hit_leaf) const {
+    if (nodes.empty())
+        return false;
+
+    uint32_t stack[traversal_stack_size];
+    int stack_size = 0;
+    uint32_t current = 0;
+    bool hit_anything = false;
+
+    while (true) {
+        const auto &node = nodes[current];
+        if (node.box.hit(r, t_min, t_max)) {
+            if (node.count > 0) {
+                if (hit_leaf(node.offset, static_cast<uint32_t>(node.count), t_max))
+                    hit_anything = true;
+                if (stack_size == 0) break;
+                current = stack[--stack_size];
+            } else if (r.sign[node.axis]) {
+                // 先访问靠近射线起点的子节点，尽早缩短 t_max
+                stack[stack_size++] = current + 1;
+                current = node.offset;
+            } else {
+                stack[stack_size++] = node.offset;
+                current = current + 1;
+            }
+        } else {
+            if (stack_size == 0) break;
+            current = stack[--stack_size];
+        }
+    }
+
+    return hit_anything;
+}
+
 #endif //RAY_TRACING_BVH_H
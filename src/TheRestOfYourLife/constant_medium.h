@@ -13,53 +13,45 @@
 
 class constant_medium : public hittable {
 public:
-    constant_medium(shared_ptr<hittable> b, double d, shared_ptr<texture> a)
-            : boundary(b), neg_inv_density(-1 / d), phase_function(make_shared<isotropic>(a)) {}
+    constant_medium(shared_ptr<hittable> b, real d, shared_ptr<texture> a)
+            : boundary(b), neg_inv_density(-1 / d), phase_function(arena_make_shared<isotropic>(a)) {}
 
-    constant_medium(shared_ptr<hittable> b, double d, Color c)
-            : boundary(b), neg_inv_density(-1 / d), phase_function(make_shared<isotropic>(c)) {}
+    constant_medium(shared_ptr<hittable> b, real d, Color c)
+            : boundary(b), neg_inv_density(-1 / d), phase_function(arena_make_shared<isotropic>(c)) {}
 
-    virtual bool hit(const Ray &r, double t_min, double t_max, hit_record &rec) const override;
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override;
 
-    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override {
+    virtual bool is_medium() const override { return true; }
+
+    // 均匀介质的透射率有解析解 exp(-密度 * 介质内的长度)
+    virtual real transmittance(const Ray &r, real t_min, real t_max) const override;
+
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override {
         return boundary->bounding_box(time0, time1, output_box);
     }
 
 public:
     shared_ptr<hittable> boundary;
     shared_ptr<material> phase_function;
-    double neg_inv_density;
+    real neg_inv_density;
 };
 
-bool constant_medium::hit(const Ray &r, double t_min, double t_max, hit_record &rec) const {
+bool constant_medium::hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
 
 //    const bool enableDebug = false; // 偶尔打印一些样本，调试用
 //    const bool debugging = enableDebug && random_double() < 0.00001;
 
-    hit_record rec1, rec2;
-
-    // 射线1 是否命中边界的包围盒 (获取前点)
-    if (!boundary->hit(r, -infinity, infinity, rec1))
+    // 射线在边界内的区间：球、立方体和它们的变换是一次解析计算，不再对边界求两次交点
+    real t1, t2;
+    if (!boundary->interval(r, t_min, t_max, t1, t2))
         return false;
 
-    // 将 射线1 与边界包围盒的命中点作为 射线2 的起点 (获取后点)
-    if (!boundary->hit(r, rec1.t + 0.0001, infinity, rec2))
-        return false;
-
-//    if (debugging) std::cerr << "\nt_min=" << rec.t << ", t_max=" << rec.t << "\n";
-
-    if (rec1.t < t_min) rec1.t = t_min;
-    if (rec2.t > t_max) rec2.t = t_max;
-
-    if (rec1.t >= rec2.t)
-        return false;
-
-    if (rec1.t < 0)
-        rec1.t = 0;
+    if (t1 < 0)
+        t1 = 0;
 
     // 获取光线在 volume 内的传播距离
     const auto ray_length = r.direction().length();
-    const auto distance_inside_boundary = (rec2.t - rec1.t) * ray_length;
+    const auto distance_inside_boundary = (t2 - t1) * ray_length;
 
     // -密度倒数 * log(0~1) 随机
     const auto hit_distance = neg_inv_density * log(random_double());
@@ -68,7 +60,7 @@ bool constant_medium::hit(const Ray &r, double t_min, double t_max, hit_record &
         return false;
 
     // 设置 hit_record 距离和交点
-    rec.t = rec1.t + hit_distance / ray_length;
+    rec.t = t1 + hit_distance / ray_length;
     rec.p = r.at(rec.t);
 
 //    if (debugging) {
@@ -79,9 +71,16 @@ bool constant_medium::hit(const Ray &r, double t_min, double t_max, hit_record &
 
     rec.normal = Vec3(1, 0, 0);     // 任意值，不参与计算
     rec.front_face = true;                      // 任意值，不参与计算
-    rec.mat_ptr = phase_function;
+    rec.mat_ptr = phase_function.get();
 
     return true;
 }
 
+real constant_medium::transmittance(const Ray &r, real t_min, real t_max) const {
+    real t1, t2;
+    if (!boundary->interval(r, t_min, t_max, t1, t2))
+        return 1;
+    return exp((t2 - t1) * r.direction().length() / neg_inv_density);
+}
+
 #endif //RAY_TRACING_CONSTANT_MEDIUM_H
@@ -0,0 +1,352 @@
+//
+// Heterogeneous participating medium: density on a voxel grid, free-flight sampled by delta tracking.
+//
+
+#ifndef RAY_TRACING_GRID_MEDIUM_H
+#define RAY_TRACING_GRID_MEDIUM_H
+
+#include "rtweekend.h"
+
+#include "hittable.h"
+#include "material.h"
+#include "perlin.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+// 体素网格上的非均匀介质，占据包围盒 bounds。体素存归一化密度，乘以 density_scale 得到消光系数 (每单位长度)，
+// 体素之间三线性插值。
+// 自由程用 delta tracking 采样：按上界密度 (majorant) 采样候选碰撞点，以 密度 / 上界 的概率接受为真实碰撞，
+// 否则是虚碰撞，继续前进。结果无偏，和 constant_medium 的解析采样一致。
+// 上界取自粗网格 (每格 majorant_cell^3 个体素) 的局部最大值，射线按 DDA 逐格前进：
+// 空的格子直接跳过，稀疏处的候选点也少，不会像全局上界那样在大片空白里产生大量虚碰撞。
+// 阴影射线的透射率用 ratio tracking 估计，同样按粗网格的上界前进。
+// march_step > 0 时改用固定步长的 ray marching (有偏，只用于对照)
+class grid_medium : public hittable {
+public:
+    grid_medium(const aabb &bounds, int nx, int ny, int nz, std::vector<float> density, real density_scale, Color albedo);
+
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override;
+
+    virtual bool is_medium() const override { return true; }
+
+    virtual real transmittance(const Ray &r, real t_min, real t_max) const override;
+
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override {
+        output_box = bounds;
+        return true;
+    }
+
+    // 点 p 处的消光系数
+    real density(const Point3 &p) const;
+
+    // 粗网格上界为 0 的格子占的比例，用于观察空白跳过的效果
+    real empty_fraction() const;
+
+public:
+    static const int majorant_cell = 8;
+
+    aabb bounds;
+    int resolution[3];
+    std::vector<float> voxels;          // x 变化最快
+    real density_scale;
+    shared_ptr<material> phase_function;
+
+    real march_step = 0;
+
+private:
+    int majorant_resolution[3];
+    std::vector<float> majorants;       // 已乘 density_scale
+    Vec3 voxel_scale;                   // 世界坐标到体素坐标的缩放
+
+    void build_majorants();
+
+    bool clip(const Ray &r, real &t0, real &t1) const;
+
+    template<typename CellFn>
+    bool walk_majorants(const Ray &r, real t0, real t1, CellFn &&visit) const;
+
+    bool delta_tracking(const Ray &r, real t0, real t1, real &t) const;
+
+    bool ray_marching(const Ray &r, real t0, real t1, real &t) const;
+
+    float voxel(int x, int y, int z) const {
+        return voxels[(static_cast<size_t>(z) * resolution[1] + y) * resolution[0] + x];
+    }
+};
+
+grid_medium::grid_medium(const aabb &bounds, int nx, int ny, int nz, std::vector<float> density, real density_scale,
+                         Color albedo)
+        : bounds(bounds), voxels(std::move(density)), density_scale(density_scale),
+          phase_function(arena_make_shared<isotropic>(albedo)) {
+    resolution[0] = nx;
+    resolution[1] = ny;
+    resolution[2] = nz;
+    auto extent = bounds.max() - bounds.min();
+    voxel_scale = Vec3(nx / extent.x(), ny / extent.y(), nz / extent.z());
+    build_majorants();
+}
+
+real grid_medium::density(const Point3 &p) const {
+    // 体素值位于体素中心，q 是以体素中心为整数点的坐标
+    int i[3];
+    real w[3];
+    for (int a = 0; a < 3; a++) {
+        auto q = (p[a] - bounds.min()[a]) * voxel_scale[a] - 0.5;
+        auto f = std::floor(q);
+        i[a] = static_cast<int>(f);
+        w[a] = q - f;
+    }
+
+    real value = 0;
+    for (int dz = 0; dz < 2; dz++) {
+        auto z = std::min(std::max(i[2] + dz, 0), resolution[2] - 1);
+        auto wz = dz ? w[2] : 1 - w[2];
+        for (int dy = 0; dy < 2; dy++) {
+            auto y = std::min(std::max(i[1] + dy, 0), resolution[1] - 1);
+            auto wy = dy ? w[1] : 1 - w[1];
+            for (int dx = 0; dx < 2; dx++) {
+                auto x = std::min(std::max(i[0] + dx, 0), resolution[0] - 1);
+                auto wx = dx ? w[0] : 1 - w[0];
+                value += wx * wy * wz * voxel(x, y, z);
+            }
+        }
+    }
+    return density_scale * value;
+}
+
+// 粗格覆盖体素坐标 [c * cell, (c + 1) * cell)，插值会用到两侧相邻的体素，各向外扩一个
+void grid_medium::build_majorants() {
+    for (int a = 0; a < 3; a++)
+        majorant_resolution[a] = (resolution[a] + majorant_cell - 1) / majorant_cell;
+    majorants.assign(static_cast<size_t>(majorant_resolution[0]) * majorant_resolution[1] * majorant_resolution[2], 0);
+
+    for (int cz = 0; cz < majorant_resolution[2]; cz++) {
+        for (int cy = 0; cy < majorant_resolution[1]; cy++) {
+            for (int cx = 0; cx < majorant_resolution[0]; cx++) {
+                float m = 0;
+                const int c[3] = {cx, cy, cz};
+                int lo[3], hi[3];
+                for (int a = 0; a < 3; a++) {
+                    lo[a] = std::max(c[a] * majorant_cell - 1, 0);
+                    hi[a] = std::min((c[a] + 1) * majorant_cell, resolution[a] - 1);
+                }
+                for (int z = lo[2]; z <= hi[2]; z++)
+                    for (int y = lo[1]; y <= hi[1]; y++)
+                        for (int x = lo[0]; x <= hi[0]; x++)
+                            m = std::max(m, voxel(x, y, z));
+                // 存成 float 时向上取整，保证不小于任何插值出的密度，ratio tracking 的权重不会变成负数
+                auto majorant = static_cast<float>(density_scale * m);
+                if (majorant < density_scale * m)
+                    majorant = std::nextafter(majorant, std::numeric_limits<float>::infinity());
+                majorants[(static_cast<size_t>(cz) * majorant_resolution[1] + cy) * majorant_resolution[0] + cx] = majorant;
+            }
+        }
+    }
+}
+
+real grid_medium::empty_fraction() const {
+    auto empty = std::count(majorants.begin(), majorants.end(), 0.0f);
+    return majorants.empty() ? 0 : real(empty) / majorants.size();
+}
+
+// 射线与包围盒的区间和 [t0, t1] 求交，结果为空时返回 false
+bool grid_medium::clip(const Ray &r, real &t0, real &t1) const {
+    for (int a = 0; a < 3; a++) {
+        auto t_near = ((r.sign[a] ? bounds.max() : bounds.min())[a] - r.orig[a]) * r.inv_dir[a];
+        auto t_far = ((r.sign[a] ? bounds.min() : bounds.max())[a] - r.orig[a]) * r.inv_dir[a];
+        t0 = t_near > t0 ? t_near : t0;
+        t1 = t_far < t1 ? t_far : t1;
+    }
+    return t0 < t1;
+}
+
+bool grid_medium::hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
+    real t0 = t_min, t1 = t_max;
+    if (!clip(r, t0, t1))
+        return false;
+
+    real t;
+    if (!(march_step > 0 ? ray_marching(r, t0, t1, t) : delta_tracking(r, t0, t1, t)))
+        return false;
+
+    rec.t = t;
+    rec.p = r.at(t);
+    rec.normal = Vec3(1, 0, 0);     // 任意值，不参与计算
+    rec.front_face = true;          // 任意值，不参与计算
+    rec.mat_ptr = phase_function.get();
+    return true;
+}
+
+// 按 DDA 逐个访问射线在 [t0, t1] 内经过的粗格，visit(进入 t, 离开 t, 上界) 返回 true 时提前结束并返回 true
+template<typename CellFn>
+bool grid_medium::walk_majorants(const Ray &r, real t0, real t1, CellFn &&visit) const {
+    const Vec3 cell_size(majorant_cell / voxel_scale.x(), majorant_cell / voxel_scale.y(), majorant_cell / voxel_scale.z());
+
+    // 起点所在的粗格，以及沿每个轴跨过下一个格子边界的 t
+    const auto start = r.at(t0);
+    int cell[3], step[3];
+    real t_next[3], t_delta[3];
+    for (int a = 0; a < 3; a++) {
+        auto c = static_cast<int>(std::floor((start[a] - bounds.min()[a]) / cell_size[a]));
+        cell[a] = std::min(std::max(c, 0), majorant_resolution[a] - 1);
+        if (r.dir[a] == 0) {
+            step[a] = 0;
+            t_next[a] = infinity;
+            t_delta[a] = infinity;
+        } else {
+            step[a] = r.sign[a] ? -1 : 1;
+            auto boundary = bounds.min()[a] + (cell[a] + (r.sign[a] ? 0 : 1)) * cell_size[a];
+            t_next[a] = (boundary - r.orig[a]) * r.inv_dir[a];
+            t_delta[a] = cell_size[a] * std::fabs(r.inv_dir[a]);
+        }
+    }
+
+    auto t = t0;
+    while (true) {
+        const int axis = t_next[0] < t_next[1] ? (t_next[0] < t_next[2] ? 0 : 2) : (t_next[1] < t_next[2] ? 1 : 2);
+        const auto t_exit = std::min(t_next[axis], t1);
+        const real majorant = majorants[(static_cast<size_t>(cell[2]) * majorant_resolution[1] + cell[1])
+                                        * majorant_resolution[0] + cell[0]];
+        if (t < t_exit && visit(t, t_exit, majorant))
+            return true;
+
+        if (t_exit >= t1)
+            return false;
+        t = t_exit;
+        cell[axis] += step[axis];
+        if (cell[axis] < 0 || cell[axis] >= majorant_resolution[axis])
+            return false;
+        t_next[axis] += t_delta[axis];
+    }
+}
+
+bool grid_medium::delta_tracking(const Ray &r, real t0, real t1, real &t) const {
+    const auto ray_length = r.direction().length();
+
+    // 指数分布无记忆：在格子边界上重新按新的上界采样，结果与全程使用同一上界相同
+    return walk_majorants(r, t0, t1, [&](real t_enter, real t_exit, real majorant) {
+        if (majorant <= 0)
+            return false;
+        const auto inv_rate = 1 / (majorant * ray_length);
+        t = t_enter;
+        while (true) {
+            t -= std::log(1 - random_double()) * inv_rate;
+            if (t >= t_exit)
+                return false;
+            if (random_double() * majorant < density(r.at(t)))
+                return true;
+        }
+    });
+}
+
+// ratio tracking：和 delta tracking 一样按上界采样候选点，但不随机决定是否碰撞，
+// 而是把每个候选点的 1 - 密度 / 上界 乘进透射率，方差比 "是否穿过" 的 0 / 1 估计小得多。
+// 透射率降到 0.1 以下后做俄罗斯轮盘，浓密区域不必走完全程
+real grid_medium::transmittance(const Ray &r, real t_min, real t_max) const {
+    real t0 = t_min, t1 = t_max;
+    if (!clip(r, t0, t1))
+        return 1;
+
+    const auto ray_length = r.direction().length();
+    if (march_step > 0) {
+        // 对照用的 ray marching：固定步长累计光学厚度
+        const auto dt = march_step / ray_length;
+        real tau = 0;
+        for (auto t = t0; t < t1; t += dt)
+            tau += density(r.at(std::min(t + 0.5 * dt, 0.5 * (t + t1)))) * (std::min(t + dt, t1) - t) * ray_length;
+        return std::exp(-tau);
+    }
+
+    real tr = 1;
+    walk_majorants(r, t0, t1, [&](real t_enter, real t_exit, real majorant) {
+        if (majorant <= 0)
+            return false;
+        const auto inv_rate = 1 / (majorant * ray_length);
+        auto t = t_enter;
+        while (true) {
+            t -= std::log(1 - random_double()) * inv_rate;
+            if (t >= t_exit)
+                return false;
+            tr *= 1 - density(r.at(t)) / majorant;
+            if (tr < 0.1) {
+                if (random_double() < 0.5) {
+                    tr = 0;
+                    return true;
+                }
+                tr *= 2;
+            }
+        }
+    });
+    return tr;
+}
+
+// 固定步长累计光学厚度，超过 -log(u) 的那一步里按该步中点的密度线性插出碰撞位置。
+// 起点随机偏移一个步长以内，避免条带；步长内密度视为常数，所以结果有偏
+bool grid_medium::ray_marching(const Ray &r, real t0, real t1, real &t) const {
+    const auto ray_length = r.direction().length();
+    const auto dt = march_step / ray_length;
+    auto remaining = -std::log(1 - random_double());   // 还要累计的光学厚度
+
+    auto segment_start = t0;
+    auto segment_end = std::min(t0 + dt * random_double(), t1);
+    while (segment_start < t1) {
+        const auto sigma = density(r.at(0.5 * (segment_start + segment_end)));
+        const auto tau = sigma * (segment_end - segment_start) * ray_length;
+        // 严格大于：random_double() 为 0 时 remaining 是 -0，密度为 0 的一段不能进来做 0 / 0
+        if (tau > remaining) {
+            t = segment_start + remaining / (sigma * ray_length);
+            return true;
+        }
+        remaining -= tau;
+        segment_start = segment_end;
+        segment_end = std::min(segment_end + dt, t1);
+    }
+    return false;
+}
+
+// 读取无文件头的 float32 体素 (本机字节序，x 变化最快)，数量必须是 nx * ny * nz。失败时返回空指针
+shared_ptr<grid_medium> load_grid_medium(const char *filename, int nx, int ny, int nz, const aabb &bounds,
+                                         real density_scale, Color albedo) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        std::cerr << "ERROR Could not open voxel file '" << filename << "'.\n";
+        return nullptr;
+    }
+    std::vector<float> density(static_cast<size_t>(nx) * ny * nz);
+    auto got = fread(density.data(), sizeof(float), density.size(), file);
+    auto extra = fgetc(file);
+    fclose(file);
+    if (got != density.size() || extra != EOF) {
+        std::cerr << "ERROR Voxel file '" << filename << "' does not hold " << nx << " x " << ny << " x " << nz
+                  << " float32 values.\n";
+        return nullptr;
+    }
+    for (auto &d: density)
+        d = d > 0 ? d : 0.0f;   // 负值或 NaN 视为空
+    return arena_make_shared<grid_medium>(bounds, nx, ny, nz, std::move(density), density_scale, albedo);
+}
+
+// 用 perlin 湍流生成一团烟：以包围盒中心为球心向外衰减，边缘被噪声侵蚀，外围大部分体素为 0
+shared_ptr<grid_medium> perlin_grid_medium(int resolution, const aabb &bounds, real density_scale, Color albedo) {
+    perlin noise;
+    const auto n = static_cast<size_t>(resolution);
+    std::vector<float> density(n * n * n);
+    for (size_t z = 0; z < n; z++) {
+        for (size_t y = 0; y < n; y++) {
+            for (size_t x = 0; x < n; x++) {
+                // 体素中心在 [-1, 1]^3 中的坐标
+                Vec3 p((x + 0.5) / n * 2 - 1, (y + 0.5) / n * 2 - 1, (z + 0.5) / n * 2 - 1);
+                auto falloff = 1 - p.length() / 0.8;
+                auto value = falloff + 0.6 * noise.turb(3 * p) - 0.35;
+                density[(z * n + y) * n + x] = static_cast<float>(clamp(2 * value, 0.0, 1.0));
+            }
+        }
+    }
+    return arena_make_shared<grid_medium>(bounds, resolution, resolution, resolution, std::move(density), density_scale,
+                                          albedo);
+}
+
+#endif //RAY_TRACING_GRID_MEDIUM_H
@@ -2,6 +2,7 @@
 #define HITTABLE_H
 
 #include "aabb.h"
+#include "light_bounds.h"
 #include "../common/rtweekend.h"
 
 class material;
@@ -10,38 +11,77 @@ struct hit_record   // hit info
 {
     Point3 p;
     Vec3 normal;
-    shared_ptr<material> mat_ptr;
-    double t;
-    double u;
-    double v;
+    const material *mat_ptr;    // 不持有所有权，避免每次求交复制 shared_ptr
+    real t;
+    real u;
+    real v;
     bool front_face;
 
     inline void set_face_normal(const Ray &r, const Vec3 &outward_normal) {
         front_face = dot(r.direction(), outward_normal) < 0;
         normal = front_face ? outward_normal : -outward_normal;
     }
+
+    // 从交点发出新射线，起点沿法线推离表面，避免自相交
+    inline Ray spawn_ray(const Vec3 &direction, real time) const {
+        return Ray(offset_ray_origin(p, normal, direction), direction, time);
+    }
 };
 
 class hittable {
 public:
-    virtual bool hit(const Ray &r, double t_min, double t_max, hit_record &rec) const = 0;
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const = 0;
 
-    virtual bool bounding_box(double time0, double time1, aabb &output_box) const = 0;
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const = 0;
+
+    // 只求最近交点的 t，不计算交点坐标、法线和 uv。未命中时 t 的值没有意义。
+    // 默认用 hit 实现，基本图元和包装器会重写成更便宜的版本
+    virtual bool intersect(const Ray &r, real t_min, real t_max, real &t) const {
+        hit_record rec;
+        if (!hit(r, t_min, t_max, rec))
+            return false;
+        t = rec.t;
+        return true;
+    }
 
-    virtual double pdf_value(const Point3 &o, const Vec3 &v) const {
+    // 射线在物体内部的区间与 [t_min, t_max] 的交集，为空时返回 false。只对凸物体 (介质的边界) 有意义。
+    // 默认求两次交点：进入点，再从进入点之后求离开点；球、立方体和变换重写成一次解析计算
+    virtual bool interval(const Ray &r, real t_min, real t_max, real &t_enter, real &t_exit) const {
+        if (!intersect(r, -infinity, infinity, t_enter))
+            return false;
+        if (!intersect(r, t_enter + surface_epsilon(r.at(t_enter)) / r.direction().length(), infinity, t_exit))
+            return false;
+        t_enter = fmax(t_enter, t_min);
+        t_exit = fmin(t_exit, t_max);
+        return t_enter < t_exit;
+    }
+
+    // 参与介质：hit 随机采样一个散射点，光线可以穿过。阴影射线不把介质当作遮挡物，而是乘以它的透射率
+    virtual bool is_medium() const { return false; }
+
+    // 射线在 [t_min, t_max] 段上穿过介质的透射率 (可以是无偏的随机估计)。表面不是介质，返回 1
+    virtual real transmittance(const Ray &r, real t_min, real t_max) const { return 1; }
+
+    virtual real pdf_value(const Point3 &o, const Vec3 &v) const {
         return 0.0;
     }
 
     virtual Vec3 random(const Vec3 &o) const {
         return Vec3(1, 0, 0);
     }
+
+    // 作为光源时的包围盒、法线锥和面积 (phi 按单位辐亮度计)，供 light_bvh 聚类。
+    // 发光的一侧由材质决定，这里只描述几何，面光源报告为双面。不支持时返回 false
+    virtual bool emitter_bounds(real time0, real time1, light_bounds &out) const {
+        return false;
+    }
 };
 
 class flip_face : public hittable{
 public:
     flip_face(shared_ptr<hittable> p) : ptr(p) {}
 
-    virtual bool hit(const Ray &r, double t_min, double t_max, hit_record &rec) const override{
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override{
         if (!ptr->hit(r, t_min, t_max, rec)){
             return false;
         }
@@ -50,133 +90,36 @@ public:
         return true;
     }
 
-    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override{
-        return ptr->bounding_box(time0, time1, output_box);
+    virtual bool intersect(const Ray &r, real t_min, real t_max, real &t) const override {
+        return ptr->intersect(r, t_min, t_max, t);
     }
 
-public:
-    shared_ptr<hittable> ptr;
-};
-
-class translate : public hittable {
-public:
-    translate(shared_ptr<hittable> p, const Vec3 &displacement) : ptr(p), offset(displacement) {}
-
-    virtual bool hit(const Ray &r, double t_min, double t_max, hit_record &rec) const override;
-
-    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override;
-
-public:
-    shared_ptr<hittable> ptr;
-    Vec3 offset;
-};
-
-bool translate::hit(const Ray &r, double t_min, double t_max, hit_record &rec) const {
-    Ray moved_r(r.origin() - offset, r.direction(), r.time());
-    if (!ptr->hit(moved_r, t_min, t_max, rec))
-        return false;
-
-    rec.p += offset;
-    rec.set_face_normal(moved_r, rec.normal);
-
-    return true;
-}
-
-bool translate::bounding_box(double time0, double time1, aabb &output_box) const {
-    if (!ptr->bounding_box(time0, time1, output_box))
-        return false;
-
-    output_box = aabb(
-            output_box.min() + offset,
-            output_box.max() + offset);
+    virtual bool interval(const Ray &r, real t_min, real t_max, real &t_enter, real &t_exit) const override {
+        return ptr->interval(r, t_min, t_max, t_enter, t_exit);
+    }
 
-    return true;
-}
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override{
+        return ptr->bounding_box(time0, time1, output_box);
+    }
 
-class rotate_y : public hittable {
-public:
-    rotate_y(shared_ptr<hittable> p, double angle);
+    virtual real pdf_value(const Point3 &o, const Vec3 &v) const override {
+        return ptr->pdf_value(o, v);
+    }
 
-    virtual bool hit(const Ray &r, double t_min, double t_max, hit_record &rec) const override;
+    virtual Vec3 random(const Vec3 &o) const override {
+        return ptr->random(o);
+    }
 
-    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override {
-        output_box = bbox;
-        return hasbox;
+    // 翻转后正面朝向相反的一侧，法线锥的轴随之反向
+    virtual bool emitter_bounds(real time0, real time1, light_bounds &out) const override {
+        if (!ptr->emitter_bounds(time0, time1, out))
+            return false;
+        out.w = -out.w;
+        return true;
     }
 
 public:
     shared_ptr<hittable> ptr;
-    double sin_theta;
-    double cos_theta;
-    bool hasbox;
-    aabb bbox;
 };
 
-rotate_y::rotate_y(shared_ptr<hittable> p, double angle) : ptr(p) {
-    auto radians = degrees_to_radians(angle);
-    sin_theta = sin(radians);
-    cos_theta = cos(radians);
-    hasbox = ptr->bounding_box(0, 1, bbox);
-
-    Point3 min(infinity, infinity, infinity);
-    Point3 max(-infinity, -infinity, -infinity);
-
-    // 旋转 AABB 的 8 个顶点，重新构造 AABB
-    for (int i = 0; i < 2; i++) {
-        for (int j = 0; j < 2; j++) {
-            for (int k = 0; k < 2; k++) {
-                auto x = i * bbox.max().x() + (1 - i) * bbox.min().x();
-                auto y = j * bbox.max().y() + (1 - j) * bbox.min().y();
-                auto z = k * bbox.max().z() + (1 - k) * bbox.min().z();
-
-                auto newx = cos_theta * x + sin_theta * z;
-                auto newz = -sin_theta * x + cos_theta * z;
-
-                Vec3 tester(newx, y, newz);
-
-                for (int c = 0; c < 3; c++) {
-                    min[c] = fmin(min[c], tester[c]);
-                    max[c] = fmax(max[c], tester[c]);
-                }
-            }
-        }
-    }
-
-    bbox = aabb(min, max);
-}
-
-bool rotate_y::hit(const Ray &r, double t_min, double t_max, hit_record &rec) const {
-
-    // 先将射线起点、方向的 xz 分量反向旋转
-    auto origin = r.origin();
-    auto direction = r.direction();
-
-    origin[0] = cos_theta * r.origin()[0] - sin_theta * r.origin()[2];
-    origin[2] = sin_theta * r.origin()[0] + cos_theta * r.origin()[2];
-
-    direction[0] = cos_theta * r.direction()[0] - sin_theta * r.direction()[2];
-    direction[2] = sin_theta * r.direction()[0] + cos_theta * r.direction()[2];
-
-    Ray rotated_r(origin, direction, r.time());
-
-    // 用反向旋转后的射线与未旋转的物体求交
-    if (!ptr->hit(rotated_r, t_min, t_max, rec))
-        return false;
-
-    // 再按条件把交点坐标和法向旋转回来
-    auto p = rec.p;
-    auto normal = rec.normal;
-
-    p[0] = cos_theta * rec.p[0] + sin_theta * rec.p[2];
-    p[2] = -sin_theta * rec.p[0] + cos_theta * rec.p[2];
-
-    normal[0] = cos_theta * rec.normal[0] + sin_theta * rec.normal[2];
-    normal[2] = -sin_theta * rec.normal[0] + cos_theta * rec.normal[2];
-
-    rec.p = p;
-    rec.set_face_normal(rotated_r, normal);
-
-    return true;
-}
-
 #endif // !HITTABLE_H
@@ -20,11 +20,13 @@ public:
 
     void add(shared_ptr<hittable> object) { objects.push_back(object); }
 
-    virtual bool hit(const Ray &r, double t_min, double t_max, hit_record &rec) const override;
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override;
 
-    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override;
+    virtual bool intersect(const Ray &r, real t_min, real t_max, real &t) const override;
 
-    virtual double pdf_value(const Point3 &o, const Vec3 &v) const override;
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override;
+
+    virtual real pdf_value(const Point3 &o, const Vec3 &v) const override;
 
     virtual Vec3 random(const Vec3 &o) const override;
 
@@ -32,7 +34,7 @@ public:
     std::vector<shared_ptr<hittable>> objects;
 };
 
-bool hittable_list::hit(const Ray &r, double t_min, double t_max, hit_record &rec) const {
+bool hittable_list::hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
     hit_record temp_rec;
     bool hit_anything = false;
     auto closest_so_far = t_max;
@@ -48,7 +50,21 @@ bool hittable_list::hit(const Ray &r, double t_min, double t_max, hit_record &re
     return hit_anything;
 }
 
-bool hittable_list::bounding_box(double time0, double time1, aabb &output_box) const {
+bool hittable_list::intersect(const Ray &r, real t_min, real t_max, real &t) const {
+    bool hit_anything = false;
+    real temp_t;
+
+    for (const auto &object: objects) {
+        if (object->intersect(r, t_min, t_max, temp_t)) {
+            hit_anything = true;
+            t = t_max = temp_t;
+        }
+    }
+
+    return hit_anything;
+}
+
+bool hittable_list::bounding_box(real time0, real time1, aabb &output_box) const {
     if (objects.empty()) return false;
 
     aabb temp_box;
@@ -64,7 +80,7 @@ bool hittable_list::bounding_box(double time0, double time1, aabb &output_box) c
     return true;
 }
 
-double hittable_list::pdf_value(const Point3 &o, const Vec3 &v) const {
+real hittable_list::pdf_value(const Point3 &o, const Vec3 &v) const {
     auto weight = 1.0 / objects.size();
     auto sum = 0.0;
 
@@ -0,0 +1,220 @@
+//
+// Transform instance: one object-to-world affine matrix per instanced object.
+//
+
+#ifndef RAY_TRACING_INSTANCE_H
+#define RAY_TRACING_INSTANCE_H
+
+#include "rtweekend.h"
+#include "transform.h"
+
+#include "hittable.h"
+#include "hittable_list.h"
+#include "bvh.h"
+#include "sphere.h"
+#include "sphere_set.h"
+#include "triangle_mesh.h"
+
+// 任意仿射变换 (旋转、缩放、平移) 下的物体。保存预先算好的矩阵和逆矩阵，
+// 求交只需把射线变换到物体空间一次，命中后把交点和法线变换回来。
+// 仿射变换不改变射线参数 t，front_face 也不变 (dot(A d, A^-T n) = dot(d, n))，不需要重新 set_face_normal。
+// 以另一个 instance 为子物体时，构造时直接合成两个矩阵，translate(rotate_y(...)) 这样的链只剩一层。
+class instance : public hittable {
+public:
+    instance(shared_ptr<hittable> p, const transform &object_to_world);
+
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override;
+
+    virtual bool intersect(const Ray &r, real t_min, real t_max, real &t) const override {
+        return ptr->intersect(to_object(r), t_min, t_max, t);
+    }
+
+    virtual bool interval(const Ray &r, real t_min, real t_max, real &t_enter, real &t_exit) const override {
+        return ptr->interval(to_object(r), t_min, t_max, t_enter, t_exit);
+    }
+
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override {
+        output_box = bbox;
+        return hasbox;
+    }
+
+    Ray to_object(const Ray &r) const {
+        return Ray(world_to_object.point(r.origin()), world_to_object.vector(r.direction()), r.time());
+    }
+
+public:
+    shared_ptr<hittable> ptr;
+    transform object_to_world;
+    transform world_to_object;
+    bool hasbox;
+    aabb bbox;
+    int levels = 1;     // 合成进这个矩阵的包装器层数
+};
+
+// 变换后物体的包围盒。列表、BVH 逐个子物体变换后再合并，球和球集合按球变换，网格按顶点变换，
+// 比只变换整体包围盒的 8 个顶点更紧，旋转后的球簇尤其明显
+bool transformed_bounds(const hittable &object, const transform &xf, real time0, real time1, aabb &output_box);
+
+// 包围盒 8 个顶点变换后的包围盒：中心变换，半宽按 |A| 投影 (Arvo)
+inline aabb transform_box(const aabb &box, const transform &xf) {
+    auto center = xf.point(box.center());
+    auto half = 0.5 * (box.max() - box.min());
+    Vec3 extent;
+    for (int i = 0; i < 3; i++)
+        extent[i] = fabs(xf.m[i][0]) * half[0] + fabs(xf.m[i][1]) * half[1] + fabs(xf.m[i][2]) * half[2];
+    return aabb(center - extent, center + extent);
+}
+
+// 半径为 radius 的球变换后的包围盒
+inline aabb transform_sphere_box(const Point3 &center, real radius, const transform &xf) {
+    auto c = xf.point(center);
+    Vec3 extent(radius * xf.row_length(0), radius * xf.row_length(1), radius * xf.row_length(2));
+    return aabb(c - extent, c + extent);
+}
+
+bool transformed_bounds(const hittable &object, const transform &xf, real time0, real time1, aabb &output_box) {
+    const hittable *p = &object;
+
+    if (auto list = dynamic_cast<const hittable_list *>(p)) {
+        if (list->objects.empty())
+            return false;
+        output_box = aabb::empty();
+        for (const auto &child: list->objects) {
+            aabb child_box;
+            if (!transformed_bounds(*child, xf, time0, time1, child_box))
+                return false;
+            output_box = surrounding_box(output_box, child_box);
+        }
+        return true;
+    }
+
+    if (auto node = dynamic_cast<const bvh_node *>(p)) {
+        aabb left_box, right_box;
+        if (!transformed_bounds(*node->left, xf, time0, time1, left_box)
+            || !transformed_bounds(*node->right, xf, time0, time1, right_box))
+            return false;
+        output_box = surrounding_box(left_box, right_box);
+        return true;
+    }
+
+    if (auto inner = dynamic_cast<const instance *>(p))
+        return transformed_bounds(*inner->ptr, xf * inner->object_to_world, time0, time1, output_box);
+
+    if (auto sphere = dynamic_cast<const Sphere *>(p)) {
+        output_box = transform_sphere_box(sphere->center, sphere->radius, xf);
+        return true;
+    }
+
+    if (auto set = dynamic_cast<const sphere_set *>(p)) {
+        if (set->size() == 0)
+            return false;
+        output_box = aabb::empty();
+        for (size_t i = 0; i < set->size(); i++) {
+            Point3 center(set->cx[i], set->cy[i], set->cz[i]);
+            output_box = surrounding_box(output_box, transform_sphere_box(center, set->radius[i], xf));
+        }
+        return true;
+    }
+
+    if (auto mesh = dynamic_cast<const triangle_mesh *>(p)) {
+        if (mesh->triangle_count() == 0)
+            return false;
+        output_box = aabb::empty();
+        for (uint32_t i = 0; i < mesh->triangle_count(); i++) {
+            for (int k = 0; k < 3; k++) {
+                auto v = xf.point(mesh->triangle_vertex(i, k));
+                output_box = surrounding_box(output_box, aabb(v, v));
+            }
+        }
+        output_box = output_box.padded();
+        return true;
+    }
+
+    aabb box;
+    if (!object.bounding_box(time0, time1, box))
+        return false;
+    output_box = transform_box(box, xf);
+    return true;
+}
+
+instance::instance(shared_ptr<hittable> p, const transform &object_to_world) : ptr(p), object_to_world(object_to_world) {
+    // 子物体也是 instance 时合成矩阵，跳过中间层
+    if (auto inner = dynamic_cast<const instance *>(ptr.get())) {
+        this->object_to_world = object_to_world * inner->object_to_world;
+        ptr = inner->ptr;
+        levels += inner->levels;
+    }
+    world_to_object = this->object_to_world.inverse();
+    hasbox = transformed_bounds(*ptr, this->object_to_world, 0, 1, bbox);
+}
+
+bool instance::hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
+    if (!ptr->hit(to_object(r), t_min, t_max, rec))
+        return false;
+
+    // 法线用逆矩阵的转置变换，缩放后需要重新归一化
+    rec.p = object_to_world.point(rec.p);
+    rec.normal = unit_vector(world_to_object.transposed_vector(rec.normal));
+    return true;
+}
+
+// 烘焙了变换的单个图元，由 scene 在构建时从只用一次的 instance 展开得到。
+// 矩阵和图元数据存放在一起，不经过 shared_ptr 和虚函数；
+// 与 instance 不同，表面信息可以像普通图元一样延迟到最近交点再计算
+template<typename T>
+class transformed_primitive {
+public:
+    transformed_primitive(const T &object, const transform &object_to_world)
+            : object(object), object_to_world(object_to_world), world_to_object(object_to_world.inverse()) {
+        hasbox = transformed_bounds(object, object_to_world, 0, 1, bbox);
+    }
+
+    bool intersect(const Ray &r, real t_min, real t_max, real &t) const {
+        return object.T::intersect(to_object(r), t_min, t_max, t);
+    }
+
+    // 物体空间的射线按同样的方式重新计算，与 intersect 得到的 t 一致
+    void surface_interaction(const Ray &r, real t, hit_record &rec) const {
+        object.T::surface_interaction(to_object(r), t, rec);
+        rec.p = object_to_world.point(rec.p);
+        rec.normal = unit_vector(world_to_object.transposed_vector(rec.normal));
+    }
+
+    bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
+        real t;
+        if (!intersect(r, t_min, t_max, t))
+            return false;
+        surface_interaction(r, t, rec);
+        return true;
+    }
+
+    bool bounding_box(real time0, real time1, aabb &output_box) const {
+        output_box = bbox;
+        return hasbox;
+    }
+
+    Ray to_object(const Ray &r) const {
+        return Ray(world_to_object.point(r.origin()), world_to_object.vector(r.direction()), r.time());
+    }
+
+public:
+    T object;
+    transform object_to_world;
+    transform world_to_object;
+    bool hasbox;
+    aabb bbox;
+};
+
+// 平移和绕 y 轴旋转是 instance 的特例
+class translate : public instance {
+public:
+    translate(shared_ptr<hittable> p, const Vec3 &displacement)
+            : instance(p, transform::translation(displacement)) {}
+};
+
+class rotate_y : public instance {
+public:
+    rotate_y(shared_ptr<hittable> p, real angle) : instance(p, transform::rotation_y(angle)) {}
+};
+
+#endif //RAY_TRACING_INSTANCE_H
@@ -0,0 +1,106 @@
+//
+// Light bounds: spatial extent, emission cone and power of one emitter or a cluster of emitters.
+//
+
+#ifndef RAY_TRACING_LIGHT_BOUNDS_H
+#define RAY_TRACING_LIGHT_BOUNDS_H
+
+#include "rtweekend.h"
+#include "aabb.h"
+
+// 发光体 (或一组发光体) 的包围盒、法线锥和功率，用于估计它对某一点的贡献 (Conty & Kulla 2018, "Importance
+// Sampling of Many Lights with Adaptive Tree Splitting"，按 pbrt-v4 的 LightBounds 实现)。
+// 所有法线都在以 w 为轴、半角 theta_o 的锥内，每个法线向外发光的范围是半角 theta_e 的锥 (面光源为 π/2)
+struct light_bounds {
+    aabb bounds;
+    Vec3 w = Vec3(0, 0, 1);
+    real phi = 0;               // 功率的估计值 (面积 x 辐亮度，省略共同的常数因子)
+    real cos_theta_o = 1;       // -1 表示法线朝向任意方向
+    real cos_theta_e = 0;
+    bool two_sided = false;     // 法线两侧都发光
+
+    // 对点 p 的贡献的上界估计：功率 / 距离² x 法线锥与 p 方向最小夹角的余弦。
+    // 是保守的：只要组内有一个灯能照到 p，结果就大于 0
+    real importance(const Point3 &p) const {
+        const auto pc = bounds.center();
+        const auto half_diagonal_squared = 0.25 * (bounds.max() - bounds.min()).length_squared();
+        const auto d2 = fmax((p - pc).length_squared(), half_diagonal_squared);   // p 在包围盒内时不会趋于无穷
+
+        // 从包围盒中心指向 p 的方向与锥轴的夹角 theta_w
+        const auto wi = unit_vector(p - pc);
+        auto cos_theta_w = dot(w, wi);
+        if (two_sided)
+            cos_theta_w = fabs(cos_theta_w);
+        if (!(cos_theta_w == cos_theta_w))     // p 恰好是中心
+            return phi / d2;
+        const auto sin_theta_w = safe_sqrt(1 - cos_theta_w * cos_theta_w);
+
+        // 从 p 看包围盒 (的外接球) 的半角 theta_b，p 在球内时取整个球面
+        const auto cos_theta_b = d2 > half_diagonal_squared ? safe_sqrt(1 - half_diagonal_squared / d2) : -1;
+        const auto sin_theta_b = safe_sqrt(1 - cos_theta_b * cos_theta_b);
+
+        // theta' = max(0, theta_w - theta_o - theta_b)：组内法线与 p 的方向的最小可能夹角
+        const auto sin_theta_o = safe_sqrt(1 - cos_theta_o * cos_theta_o);
+        const auto cos_theta_x = cos_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o);
+        const auto sin_theta_x = sin_sub_clamped(sin_theta_w, cos_theta_w, sin_theta_o, cos_theta_o);
+        const auto cos_theta_p = cos_sub_clamped(sin_theta_x, cos_theta_x, sin_theta_b, cos_theta_b);
+        if (cos_theta_p <= cos_theta_e)
+            return 0;
+        return phi * cos_theta_p / d2;
+    }
+
+    static real safe_sqrt(real x) { return sqrt(fmax(x, real(0))); }
+
+    // cos(max(0, a - b)) 和 sin(max(0, a - b))，只用 a、b 的正弦和余弦计算
+    static real cos_sub_clamped(real sin_a, real cos_a, real sin_b, real cos_b) {
+        return cos_a > cos_b ? 1 : cos_a * cos_b + sin_a * sin_b;
+    }
+
+    static real sin_sub_clamped(real sin_a, real cos_a, real sin_b, real cos_b) {
+        return cos_a > cos_b ? 0 : sin_a * cos_b - cos_a * sin_b;
+    }
+};
+
+// 包住 a 和 b 的光源范围：包围盒取并集，功率相加，法线锥取包住两个锥的最小锥
+inline light_bounds union_bounds(const light_bounds &a, const light_bounds &b) {
+    if (a.phi == 0)
+        return b;
+    if (b.phi == 0)
+        return a;
+
+    light_bounds u;
+    u.bounds = surrounding_box(a.bounds, b.bounds);
+    u.phi = a.phi + b.phi;
+    u.cos_theta_e = fmin(a.cos_theta_e, b.cos_theta_e);
+    u.two_sided = a.two_sided || b.two_sided;
+
+    const auto theta_a = acos(clamp(a.cos_theta_o, -1, 1));
+    const auto theta_b = acos(clamp(b.cos_theta_o, -1, 1));
+    const auto theta_d = acos(clamp(dot(a.w, b.w), -1, 1));
+    if (fmin(theta_d + theta_b, pi) <= theta_a) {
+        u.w = a.w;
+        u.cos_theta_o = a.cos_theta_o;
+        return u;
+    }
+    if (fmin(theta_d + theta_a, pi) <= theta_b) {
+        u.w = b.w;
+        u.cos_theta_o = b.cos_theta_o;
+        return u;
+    }
+
+    // 新锥的半角 theta_o 从 a 的轴转过 theta_o - theta_a 到两个锥中间
+    const auto theta_o = 0.5 * (theta_a + theta_d + theta_b);
+    const auto axis = cross(a.w, b.w);
+    if (theta_o >= pi || axis.length_squared() == 0) {
+        u.cos_theta_o = -1;
+        return u;
+    }
+    const auto k = unit_vector(axis);
+    const auto theta_r = theta_o - theta_a;
+    // Rodrigues 旋转，k 与 a.w 垂直
+    u.w = unit_vector(cos(theta_r) * a.w + sin(theta_r) * cross(k, a.w));
+    u.cos_theta_o = cos(theta_o);
+    return u;
+}
+
+#endif //RAY_TRACING_LIGHT_BOUNDS_H
@@ -0,0 +1,306 @@
+//
+// Light BVH: emitters clustered by position, emission cone and power, sampled stochastically per shading point.
+//
+
+#ifndef RAY_TRACING_LIGHT_BVH_H
+#define RAY_TRACING_LIGHT_BVH_H
+
+#include "rtweekend.h"
+
+#include "hittable.h"
+#include "hittable_list.h"
+#include "bvh.h"
+#include "light_bounds.h"
+
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// 灯 light 以 radiance 发光时的范围和功率。不认识的形状按包围盒估计：全向发光，面积取包围盒表面积的一半。
+// 连包围盒都没有时返回 false
+inline bool emitter_light_bounds(const hittable &light, real time0, real time1, real radiance, light_bounds &out) {
+    out = light_bounds();
+    if (!light.emitter_bounds(time0, time1, out)) {
+        if (!light.bounding_box(time0, time1, out.bounds))
+            return false;
+        out.phi = 0.5 * out.bounds.surface_area();
+        out.cos_theta_o = -1;
+        out.two_sided = true;
+    }
+    out.phi *= radiance;
+    return true;
+}
+
+// 光源树的节点按深度优先顺序存放，左子节点紧随父节点，每个叶子一个灯
+struct light_bvh_node {
+    light_bounds bounds;
+    uint32_t child_or_light;    // 叶子：灯的编号；内部节点：右子节点的下标
+    bool leaf;
+};
+
+// 多光源的重要性采样 (pbrt-v4 的 BVHLightSampler)：从根节点往下，按两个子节点对着色点的 importance 之比随机选一个，
+// 到达叶子时选中的概率是沿途比值的乘积，与灯的数量无关地 O(log n) 完成，而且功率大、距离近、朝向着色点的灯更容易被选中。
+// pdf_value 只沿射线穿过的包围盒向下，把每个叶子的选择概率乘以灯自己的 pdf_value 累加：
+// 方向 v 能打到的灯都在射线穿过的包围盒里，所以和 random 的采样分布完全一致。
+// 和 hittable_list 一样作为 lights 传给 ray_color，灯本身仍然保存在场景里，这里只持有指针
+class light_bvh : public hittable {
+public:
+    light_bvh() = default;
+
+    // 只有几何、不知道发光强度和朝向的光源列表：按单位辐亮度、双面发光估计
+    light_bvh(const hittable_list &list, real time0, real time1) {
+        for (const auto &object: list.objects)
+            add(object);
+        build(time0, time1);
+    }
+
+    // radiance 是自发光的强度，one_sided 表示只有外法线一侧发光 (diffuse_light，flip_face 翻转后朝另一侧)。
+    // 加完所有灯之后调用 build
+    void add(shared_ptr<hittable> light, real radiance = 1, bool one_sided = false) {
+        lights.push_back(light);
+        radiances.push_back(radiance);
+        one_sides.push_back(one_sided);
+    }
+
+    void build(real time0, real time1);
+
+    size_t light_count() const { return lights.size(); }
+
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override;
+
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override {
+        output_box = nodes.empty() ? aabb::empty() : nodes[0].bounds.bounds;
+        return !nodes.empty();
+    }
+
+    virtual real pdf_value(const Point3 &o, const Vec3 &v) const override;
+
+    virtual Vec3 random(const Vec3 &o) const override;
+
+public:
+    std::vector<shared_ptr<hittable>> lights;
+    std::vector<light_bvh_node> nodes;
+
+private:
+    std::vector<real> radiances;
+    std::vector<bool> one_sides;
+
+    // 深度限制和遍历栈的大小与 flat_bvh 相同：超过 median_split_depth 层后按中位数对半分
+    uint32_t build_recursive(std::vector<std::pair<uint32_t, light_bounds>> &items, size_t start, size_t end, int depth);
+
+    // 两个子节点中选第一个的概率，两者都照不到 o 时为 -1
+    real first_child_probability(uint32_t node, const Point3 &o) const {
+        const auto i0 = nodes[node + 1].bounds.importance(o);
+        const auto i1 = nodes[nodes[node].child_or_light].bounds.importance(o);
+        return i0 + i1 > 0 ? i0 / (i0 + i1) : -1;
+    }
+
+    // 分桶 SAH 的光源版本 (SAOH)：功率 x 法线锥覆盖的立体角 M_omega x 包围盒表面积，
+    // 细长的包围盒沿短轴划分时乘以 kr 加以惩罚
+    static real cost(const light_bounds &b, real kr) {
+        const auto theta_o = acos(clamp(b.cos_theta_o, -1, 1));
+        const auto theta_e = acos(clamp(b.cos_theta_e, -1, 1));
+        const auto theta_w = fmin(theta_o + theta_e, pi);
+        const auto sin_theta_o = light_bounds::safe_sqrt(1 - b.cos_theta_o * b.cos_theta_o);
+        const auto m_omega = 2 * pi * (1 - b.cos_theta_o)
+                             + pi / 2 * (2 * theta_w * sin_theta_o - cos(theta_o - 2 * theta_w)
+                                         - 2 * theta_o * sin_theta_o + b.cos_theta_o);
+        return b.phi * m_omega * kr * b.bounds.surface_area();
+    }
+};
+
+void light_bvh::build(real time0, real time1) {
+    nodes.clear();
+
+    std::vector<std::pair<uint32_t, light_bounds>> items;
+    items.reserve(lights.size());
+    for (size_t i = 0; i < lights.size(); i++) {
+        light_bounds b;
+        if (!emitter_light_bounds(*lights[i], time0, time1, radiances[i], b)) {
+            std::cerr << "No bounding box in light_bvh constructor.\n";
+            continue;
+        }
+        b.two_sided = b.two_sided && !one_sides[i];
+        if (b.phi > 0)
+            items.emplace_back(static_cast<uint32_t>(i), b);
+    }
+
+    if (items.empty())
+        return;
+    nodes.reserve(2 * items.size() - 1);
+    build_recursive(items, 0, items.size(), 0);
+}
+
+uint32_t light_bvh::build_recursive(std::vector<std::pair<uint32_t, light_bounds>> &items, size_t start, size_t end, int depth) {
+    if (end - start == 1) {
+        nodes.push_back({items[start].second, items[start].first, true});
+        return static_cast<uint32_t>(nodes.size() - 1);
+    }
+
+    light_bounds node_bounds;
+    aabb centroid_box = aabb::empty();
+    for (auto i = start; i < end; i++) {
+        node_bounds = union_bounds(node_bounds, items[i].second);
+        auto c = items[i].second.bounds.center();
+        centroid_box = surrounding_box(centroid_box, aabb(c, c));
+    }
+
+    // 在三个轴上分桶，选 SAOH 代价最小的划分
+    const int bin_count = 12;
+    const auto diagonal = node_bounds.bounds.max() - node_bounds.bounds.min();
+    const auto max_extent = fmax(diagonal.x(), fmax(diagonal.y(), diagonal.z()));
+    const auto extent = centroid_box.max() - centroid_box.min();
+    real best_cost = infinity;
+    int best_axis = -1, best_split = -1;
+
+    for (int axis = 0; axis < 3 && depth < flat_bvh::median_split_depth; axis++) {
+        if (!(extent[axis] > 0))
+            continue;
+        auto bin_of = [&](const light_bounds &b) {
+            auto bin = static_cast<int>(bin_count * (b.bounds.center()[axis] - centroid_box.min()[axis]) / extent[axis]);
+            return std::min(std::max(bin, 0), bin_count - 1);
+        };
+
+        light_bounds bins[bin_count];
+        for (auto i = start; i < end; i++) {
+            auto &b = bins[bin_of(items[i].second)];
+            b = union_bounds(b, items[i].second);
+        }
+
+        const auto kr = max_extent / diagonal[axis];
+        light_bounds right[bin_count];
+        for (int b = bin_count - 1; b > 0; b--)
+            right[b] = union_bounds(b + 1 < bin_count ? right[b + 1] : light_bounds(), bins[b]);
+
+        light_bounds left;
+        for (int b = 0; b < bin_count - 1; b++) {
+            left = union_bounds(left, bins[b]);
+            if (left.phi == 0 || right[b + 1].phi == 0)
+                continue;
+            auto c = cost(left, kr) + cost(right[b + 1], kr);
+            if (c < best_cost) {
+                best_cost = c;
+                best_axis = axis;
+                best_split = b;
+            }
+        }
+    }
+
+    auto mid = start + (end - start) / 2;
+    if (best_axis >= 0) {
+        const auto axis = best_axis;
+        auto it = std::partition(items.begin() + start, items.begin() + end, [&](const std::pair<uint32_t, light_bounds> &item) {
+            auto bin = static_cast<int>(bin_count * (item.second.bounds.center()[axis] - centroid_box.min()[axis]) / extent[axis]);
+            return std::min(std::max(bin, 0), bin_count - 1) <= best_split;
+        });
+        mid = static_cast<size_t>(it - items.begin());
+    }
+    // 所有质心重合或者树已经很深时按原来的顺序对半分
+    if (mid == start || mid == end)
+        mid = start + (end - start) / 2;
+
+    auto node = static_cast<uint32_t>(nodes.size());
+    nodes.push_back({node_bounds, 0, false});
+    build_recursive(items, start, mid, depth + 1);
+    auto right = build_recursive(items, mid, end, depth + 1);
+    nodes[node].child_or_light = right;
+    return node;
+}
+
+Vec3 light_bvh::random(const Vec3 &o) const {
+    if (nodes.empty())
+        return Vec3(1, 0, 0);
+
+    // 一个随机数逐层重新映射到 [0, 1)，整条路径只消耗一维
+    auto u = random_double();
+    uint32_t current = 0;
+    while (!nodes[current].leaf) {
+        auto p0 = first_child_probability(current, o);
+        if (p0 < 0)
+            p0 = 0.5;   // 两侧都照不到 o，选哪个都没有贡献
+        if (u < p0) {
+            u = std::min(u / p0, one_minus_epsilon);
+            current = current + 1;
+        } else {
+            u = std::min((u - p0) / (1 - p0), one_minus_epsilon);
+            current = nodes[current].child_or_light;
+        }
+    }
+    // 灯上的点从下一对维度开始
+    begin_dimension_block(2);
+    return lights[nodes[current].child_or_light]->random(o);
+}
+
+real light_bvh::pdf_value(const Point3 &o, const Vec3 &v) const {
+    if (nodes.empty())
+        return 0;
+
+    const Ray r(o, v);
+    uint32_t stack[flat_bvh::traversal_stack_size];
+    real stack_probability[flat_bvh::traversal_stack_size];
+    int stack_size = 0;
+    uint32_t current = 0;
+    real probability = 1;
+    real sum = 0;
+
+    while (true) {
+        const auto &node = nodes[current];
+        if (node.bounds.bounds.hit(r, 0, infinity)) {
+            if (node.leaf) {
+                sum += probability * lights[node.child_or_light]->pdf_value(o, v);
+            } else {
+                auto p0 = first_child_probability(current, o);
+                if (p0 >= 0) {
+                    if (p0 < 1) {
+                        stack[stack_size] = node.child_or_light;
+                        stack_probability[stack_size++] = probability * (1 - p0);
+                    }
+                    if (p0 > 0) {
+                        current = current + 1;
+                        probability *= p0;
+                        continue;
+                    }
+                }
+            }
+        }
+        if (stack_size == 0)
+            break;
+        current = stack[--stack_size];
+        probability = stack_probability[stack_size];
+    }
+
+    return sum;
+}
+
+bool light_bvh::hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
+    if (nodes.empty())
+        return false;
+
+    uint32_t stack[flat_bvh::traversal_stack_size];
+    int stack_size = 0;
+    uint32_t current = 0;
+    bool hit_anything = false;
+
+    while (true) {
+        const auto &node = nodes[current];
+        if (node.bounds.bounds.hit(r, t_min, t_max)) {
+            if (node.leaf) {
+                if (lights[node.child_or_light]->hit(r, t_min, t_max, rec)) {
+                    hit_anything = true;
+                    t_max = rec.t;
+                }
+            } else {
+                stack[stack_size++] = node.child_or_light;
+                current = current + 1;
+                continue;
+            }
+        }
+        if (stack_size == 0)
+            break;
+        current = stack[--stack_size];
+    }
+
+    return hit_anything;
+}
+
+#endif //RAY_TRACING_LIGHT_BVH_H
@@ -0,0 +1,151 @@
+//
+// Light list: emitters found in the scene, selected in proportion to their power through an alias table.
+//
+
+#ifndef RAY_TRACING_LIGHT_LIST_H
+#define RAY_TRACING_LIGHT_LIST_H
+
+#include "rtweekend.h"
+#include "alias_table.h"
+
+#include "hittable.h"
+#include "hittable_list.h"
+#include "material.h"
+#include "bvh.h"
+#include "sphere.h"
+#include "aarect.h"
+#include "light_bvh.h"
+
+#include <iostream>
+#include <vector>
+
+// 场景中的一个发光体和它的辐亮度 (RGB 平均值)
+struct emitter {
+    shared_ptr<hittable> object;
+    real radiance;
+};
+
+// object 是否是 (可能被 flip_face 包装的) 发光的矩形或球，是时返回它的材质
+inline const diffuse_light *emitting_material(const hittable &object) {
+    const hittable *p = &object;
+    if (auto flip = dynamic_cast<const flip_face *>(p))
+        return emitting_material(*flip->ptr);
+
+    const material *m = nullptr;
+    if (auto rect = dynamic_cast<const xy_rect *>(p))
+        m = rect->mp.get();
+    else if (auto rect = dynamic_cast<const xz_rect *>(p))
+        m = rect->mp.get();
+    else if (auto rect = dynamic_cast<const yz_rect *>(p))
+        m = rect->mp.get();
+    else if (auto sphere = dynamic_cast<const Sphere *>(p))
+        m = sphere->mat_ptr.get();
+    return m && m->type == material_type::diffuse_light ? static_cast<const diffuse_light *>(m) : nullptr;
+}
+
+inline void find_emitters(const shared_ptr<hittable> &object, real time0, real time1, std::vector<emitter> &out) {
+    const hittable *p = object.get();
+    if (auto list = dynamic_cast<const hittable_list *>(p)) {
+        for (const auto &child: list->objects)
+            find_emitters(child, time0, time1, out);
+    } else if (auto node = dynamic_cast<const bvh_node *>(p)) {
+        find_emitters(node->left, time0, time1, out);
+        find_emitters(node->right, time0, time1, out);
+    } else if (auto light = emitting_material(*p)) {
+        // 纹理的发光取包围盒中心处的值作为代表
+        aabb box;
+        object->bounding_box(time0, time1, box);
+        auto c = texture_value(*light->emit, 0.5, 0.5, box.center());
+        out.push_back({object, (c.x() + c.y() + c.z()) / 3});
+    }
+}
+
+// 场景中所有用 diffuse_light 材质的矩形和球 (包括 flip_face 包装的)，取代手工搭建的 lights。
+// 变换、实例和网格里的发光体不做直接光采样，只能被弹射射线打到，结果仍然无偏
+inline std::vector<emitter> find_emitters(const hittable_list &world, real time0, real time1) {
+    std::vector<emitter> emitters;
+    for (const auto &object: world.objects)
+        find_emitters(object, time0, time1, emitters);
+    return emitters;
+}
+
+// 按功率 (辐亮度 x 面积) 选灯：建表后用别名表 O(1) 选择，pdf_value 是各灯的选择概率乘以它自己的 pdf_value 之和。
+// 灯的亮度和大小相差很大时，暗的灯不再分走一半阴影射线。灯多到成千上万时用 light_bvh
+class light_list : public hittable {
+public:
+    light_list() = default;
+
+    // 加完所有灯之后调用 build
+    void add(shared_ptr<hittable> light, real radiance = 1) {
+        lights.push_back(light);
+        radiances.push_back(radiance);
+    }
+
+    void build(real time0, real time1) {
+        std::vector<double> power(lights.size(), 0.0);
+        for (size_t i = 0; i < lights.size(); i++) {
+            light_bounds b;
+            if (emitter_light_bounds(*lights[i], time0, time1, radiances[i], b))
+                power[i] = b.phi;
+            else
+                std::cerr << "No bounding box in light_list constructor.\n";
+        }
+        table = alias_table(power);
+    }
+
+    size_t light_count() const { return lights.size(); }
+
+    real probability(size_t i) const { return table.probability(i); }
+
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override {
+        bool hit_anything = false;
+        for (const auto &light: lights) {
+            if (light->hit(r, t_min, t_max, rec)) {
+                hit_anything = true;
+                t_max = rec.t;
+            }
+        }
+        return hit_anything;
+    }
+
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override {
+        output_box = aabb::empty();
+        for (const auto &light: lights) {
+            aabb box;
+            if (!light->bounding_box(time0, time1, box))
+                return false;
+            output_box = surrounding_box(output_box, box);
+        }
+        return !lights.empty();
+    }
+
+    virtual real pdf_value(const Point3 &o, const Vec3 &v) const override {
+        real sum = 0;
+        for (size_t i = 0; i < lights.size(); i++) {
+            if (table.probability(i) > 0)
+                sum += table.probability(i) * lights[i]->pdf_value(o, v);
+        }
+        return sum;
+    }
+
+    virtual Vec3 random(const Vec3 &o) const override {
+        if (lights.empty())
+            return Vec3(1, 0, 0);
+        if (lights.size() == 1)
+            return lights[0]->random(o);
+
+        // 选灯用一维，灯上的点从下一对维度开始
+        auto i = table.sample(random_double());
+        begin_dimension_block(2);
+        return lights[i]->random(o);
+    }
+
+public:
+    std::vector<shared_ptr<hittable>> lights;
+
+private:
+    std::vector<real> radiances;
+    alias_table table;
+};
+
+#endif //RAY_TRACING_LIGHT_LIST_H
@@ -9,125 +9,322 @@
 #include "src/TheRestOfYourLife/material.h"
 
 #include "sphere.h"
+#include "sphere_set.h"
 #include "hittable_list.h"
 #include "moving_sphere.h"
 #include "bvh.h"
 #include "texture.h"
 #include "aarect.h"
 #include "box.h"
+#include "instance.h"
+#include "obj_loader.h"
+#include "point_cloud.h"
 #include "constant_medium.h"
+#include "grid_medium.h"
 #include "pdf.h"
+#include "light_bvh.h"
+#include "light_list.h"
+#include "blue_noise.h"
+#include "scene.h"
+#include "alloc_counter.h"
+#include "memory_usage.h"
 
 #include <time.h>
 #include <iostream>
+#include <string>
+
+
+// 一个像素样本的维度布局 (sampler.h)。第一组是相机：像素内偏移、镜头、快门时间；
+// 之后每次弹射一组，各个用途在组内的偏移固定，需要两个数的用途从偶数维开始，落在同一对 Sobol 维度上
+enum sample_dimension : uint32_t {
+    dim_pixel = 0,          // 像素内偏移 (2)
+    dim_lens = 2,           // 镜头上的点 (2)
+    dim_time = 4,           // 快门时间 (1)
+
+    // 以下是弹射组内的偏移，按 ray_color 中使用的先后排列
+    dim_medium = 0,         // 介质中的自由程 (4)
+    dim_fog_light = 4,      // 等角采样朝向的灯上一点 (4)
+    dim_fog_distance = 8,   // 雾中散射距离：选择分布、距离 (2)
+    dim_fog_shadow = 10,    // 雾中散射点的直接光 (4)
+    dim_scatter = 14,       // 材质的散射 (玻璃的反射 / 折射、金属的模糊) (4)
+    dim_light = 18,         // 表面的直接光：选灯和灯上的点 (4)
+    dim_bsdf = 22,          // 按材质采样继续弹射的方向 (2)
+    dim_roulette = 24,      // 俄罗斯轮盘 (1)
+    dims_per_bounce = 26
+};
+
+// 路径长度：max_depth 是硬上限，从第 roulette_depth 次弹射起由俄罗斯轮盘按路径通量决定是否继续
+const int max_depth = 50;
+int roulette_depth = 3;
+
+// 渲染统计：路径段数 (ray_color 的调用次数) 和阴影射线数
+size_t path_segments = 0;
+size_t shadow_rays = 0;
+
+/// 俄罗斯轮盘：以 min(1, 路径通量的最大分量) 的概率继续，继续的路径除以这个概率，估计仍然无偏。
+/// 封闭场景里多次反射后已经很暗的路径大多在这里结束，不再一直弹射到 max_depth。返回存活概率，0 表示结束
+real roulette_survival(const Color &throughput, int bounce, uint32_t dim) {
+    if (bounce < roulette_depth)
+        return 1;
+    skip_to_dimension(dim + dim_roulette);
+    const auto p = std::min<real>(1, std::max(throughput.x(), std::max(throughput.y(), throughput.z())));
+    return random_double() < p ? p : 0;
+}
 
-
-/// 发射射线，返回颜色
-Color ray_color(const Ray &r, const Color &background, const hittable &world, shared_ptr<hittable> lights, int depth) {
-    hit_record rec;
-
-    // 迭代深度，也可以用 RR 作为终止条件
-    if (depth <= 0) {
+/// 全局雾对射线 [0, segment_end] 一段的单次散射：在雾中取一个距离，从那里向光源做一次直接光采样。
+/// 距离按等角分布 (朝采样到的灯上一点) 和透射率的指数分布各一半概率选取，用两者的平均密度
+/// (one-sample MIS, balance heuristic) 加权：靠近灯的一段由等角采样负责，稠密的雾由指数分布负责。
+/// segment_end 之后的雾不计入：其他介质在它之前散射的概率恰好是它们的透射率，所以只乘全局雾自己的透射率
+Color fog_inscatter(const Ray &r, real segment_end, const scene &world, const hittable &lights, uint32_t dim) {
+    auto fog = world.atmosphere_medium();
+    real t0, t1;
+    if (!fog || !fog->boundary->interval(r, 0, segment_end, t0, t1))
         return Color(0, 0, 0);
-    }
 
-    if (!world.hit(r, 0.001, infinity, rec)) {
-        return background;
-    }
+    // 按单位方向上的距离计算
+    const auto ray_length = r.direction().length();
+    const auto unit_direction = r.direction() / ray_length;
+    const auto s0 = t0 * ray_length;
+    const auto s1 = t1 * ray_length;
+    const auto sigma = -1 / fog->neg_inv_density;
+
+    exponential_pdf transmittance_pdf(sigma, s0, s1);
+    equiangular_pdf light_distance_pdf;
+    hit_record light_rec;
+    skip_to_dimension(dim + dim_fog_light);
+    Ray to_light(r.origin(), lights.random(r.origin()), r.time());
+    if (lights.hit(to_light, 0, infinity, light_rec))
+        light_distance_pdf = equiangular_pdf(r.origin(), unit_direction, light_rec.p, s0, s1);
+    const bool equiangular = light_distance_pdf.valid();
+
+    skip_to_dimension(dim + dim_fog_distance);
+    const auto s = equiangular && random_double() < 0.5 ? light_distance_pdf.generate() : transmittance_pdf.generate();
+    const auto pdf_val = equiangular ? 0.5 * (light_distance_pdf.value(s) + transmittance_pdf.value(s))
+                                     : transmittance_pdf.value(s);
+    if (!(pdf_val > 0) || s < s0 || s > s1)
+        return Color(0, 0, 0);
 
-    // 击中球体
-    // 直接输出法线颜色
-    // return 0.5 * (rec.normal + Color(1, 1, 1));
+    // 散射点上的反照率和相函数
+    hit_record rec;
+    rec.t = s / ray_length;
+    rec.p = r.at(rec.t);
+    rec.normal = Vec3(1, 0, 0);
+    rec.front_face = true;
+    rec.u = rec.v = 0;
+    rec.mat_ptr = fog->phase_function.get();
+    scatter_record srec;
+    material_scatter(*rec.mat_ptr, r, rec, srec);
 
-    // 单位球体反射：中心点沿单位法线移动的单位球体
-    // Point3 target = rec.p + rec.normal + random_unit_vector();
+    skip_to_dimension(dim + dim_fog_shadow);
+    hittable_pdf light_pdf(lights, rec.p);
+    Ray shadow(rec.p, light_pdf.generate(), r.time());
+    auto light_val = light_pdf.value(shadow.direction());
+    if (!(light_val > 0))
+        return Color(0, 0, 0);
+    shadow_rays++;
+    if (!world.scene::hit_surface(shadow, 0, infinity, light_rec))
+        return Color(0, 0, 0);
+    auto light_emitted = material_emitted(*light_rec.mat_ptr, shadow, light_rec, light_rec.u, light_rec.v, light_rec.p);
+    if (light_emitted.near_zero())
+        return Color(0, 0, 0);
 
-    // 单位半球反射
-    // Point3 target = rec.p + random_in_hemisphere(rec.normal);
+    return exp(-sigma * (s - s0)) * sigma * srec.attenuation
+           * material_scattering_pdf(*rec.mat_ptr, r, rec, shadow) * light_emitted
+           * world.scene::transmittance(shadow, 0, light_rec.t) / (light_val * pdf_val);
+}
 
-    // 输出半衰漫反射
-    // return 0.5 * ray_color(Ray(rec.p, target - rec.p), world, depth - 1);
+/// 发射射线，返回颜色。
+/// 路径追踪写成循环：throughput 是相机到当前射线的路径通量 (各次弹射 f * cos / pdf 的乘积)，
+/// 每个顶点的自发光和直接光乘以它累加到 radiance。栈的大小与路径长度无关，路径在任何一步都可以直接结束。
+/// 每个漫反射 / 介质散射点做一次直接光采样 (next event estimation)：向光源采样方向，阴影射线找到最近的表面，
+/// 它的自发光乘以途中介质的透射率。继续弹射的方向只按材质采样，scatter_pdf 是它的概率密度，
+/// 弹射射线命中发光体时和直接光采样按 balance heuristic 分配权重；相机射线和镜面反射为 0，自发光不加权。
+/// 场景有全局雾时，每条射线经过雾的一段由 fog_inscatter 估计单次散射，雾中的散射点不再做直接光采样，
+/// 从散射点出发的射线 scatter_pdf < 0：命中已由 fog_inscatter 计入的光源时自发光为 0。
+/// 从第 roulette_depth 次弹射起由俄罗斯轮盘结束路径，max_depth 是硬上限
+Color ray_color(const Ray &camera_ray, const Color &background, const scene &world, const hittable &lights) {
+    Color radiance(0, 0, 0);
+    Color throughput(1, 1, 1);
+    Ray r = camera_ray;
+    real scatter_pdf = 0;
+    hit_record rec;
+    scatter_record srec;
+    const auto fog = world.atmosphere_medium();
 
-//    Ray scattered;      // 散播射线
-//    Color albedo;       // 能量衰减值 (材质反照率、漫射颜色)
-//    Color emitted = rec.mat_ptr->emitted(r, rec, rec.u, rec.v, rec.p);  // 自发光颜色
-//    double pdf_val;
+    for (int bounce = 0; bounce < max_depth; bounce++) {
+        path_segments++;
 
-//    // 击中自发光材质
-//    if (!rec.mat_ptr->scatter(r, rec, albedo, scattered, pdf_val)) {
-//        return emitted;
-//    }
+        // 本次弹射使用的一组样本维度
+        const auto dim = begin_dimension_block(dims_per_bounce);
 
-//    // 光源上随机一点
-//    auto on_light = Point3(random_double(214, 343), 554, random_double(227, 332));
-//    // 着色点到光源方向
-//    auto to_light = on_light - rec.p;
-//    auto distance_squared = to_light.length_squared();
-//    to_light = unit_vector(to_light);
-//
-//    if (dot(to_light, rec.normal) < 0) {
-//        return emitted;
-//    }
-//
-//    double light_area = (343 - 213) * (332 - 227);
-//    auto light_cosine = fabs(to_light.y());
-//    if (light_cosine < 0.000001) {
-//        return emitted;
-//    }
-//
-//    pdf = distance_squared / (light_cosine * light_area);
-//    scattered = Ray(rec.p, to_light, r.time());
+        // 新射线的起点已经推离表面 (hit_record::spawn_ray)，t_min 不再需要固定的 0.001
+        real segment_end;
+        const bool hit_anything = world.scene::hit(r, 0, infinity, rec, segment_end);
+        radiance += throughput * fog_inscatter(r, segment_end, world, lights, dim);
+        if (!hit_anything) {
+            radiance += throughput * background;
+            break;
+        }
 
-//    cosine_pdf p(rec.normal);
-//    scattered = Ray(rec.p, p.generate(), r.time());
-//    pdf_val = p.value(scattered.direction());
+        // 击中球体
+        // 直接输出法线颜色
+        // return 0.5 * (rec.normal + Color(1, 1, 1));
+
+        // 单位球体反射：中心点沿单位法线移动的单位球体
+        // Point3 target = rec.p + rec.normal + random_unit_vector();
+
+        // 单位半球反射
+        // Point3 target = rec.p + random_in_hemisphere(rec.normal);
+
+        // 输出半衰漫反射
+        // return 0.5 * ray_color(Ray(rec.p, target - rec.p), world, depth - 1);
+
+    //    Ray scattered;      // 散播射线
+    //    Color albedo;       // 能量衰减值 (材质反照率、漫射颜色)
+    //    Color emitted = rec.mat_ptr->emitted(r, rec, rec.u, rec.v, rec.p);  // 自发光颜色
+    //    double pdf_val;
+
+    //    // 击中自发光材质
+    //    if (!rec.mat_ptr->scatter(r, rec, albedo, scattered, pdf_val)) {
+    //        return emitted;
+    //    }
+
+    //    // 光源上随机一点
+    //    auto on_light = Point3(random_double(214, 343), 554, random_double(227, 332));
+    //    // 着色点到光源方向
+    //    auto to_light = on_light - rec.p;
+    //    auto distance_squared = to_light.length_squared();
+    //    to_light = unit_vector(to_light);
+    //
+    //    if (dot(to_light, rec.normal) < 0) {
+    //        return emitted;
+    //    }
+    //
+    //    double light_area = (343 - 213) * (332 - 227);
+    //    auto light_cosine = fabs(to_light.y());
+    //    if (light_cosine < 0.000001) {
+    //        return emitted;
+    //    }
+    //
+    //    pdf = distance_squared / (light_cosine * light_area);
+    //    scattered = Ray(rec.p, to_light, r.time());
+
+    //    cosine_pdf p(rec.normal);
+    //    scattered = Ray(rec.p, p.generate(), r.time());
+    //    pdf_val = p.value(scattered.direction());
+
+    //    hittable_pdf light_pdf(lights, rec.p);
+    //    scattered = Ray(rec.p, light_pdf.generate(), r.time());
+    //    pdf_val = light_pdf.value(scattered.direction());
+
+    //    auto p0 = make_shared<hittable_pdf>(lights, rec.p);
+    //    auto p1 = make_shared<cosine_pdf>(rec.normal);
+    //    mixture_pdf mixed_pdf(p0, p1);
+    //    scattered = Ray(rec.p, mixed_pdf.generate(), r.time());
+    //    pdf_val = mixed_pdf.value(scattered.direction());
+
+        Color emitted = material_emitted(*rec.mat_ptr, r, rec, rec.u, rec.v, rec.p);  // 自发光颜色
+        if (scatter_pdf != 0 && !emitted.near_zero()) {
+            auto light_pdf = lights.pdf_value(r.origin(), r.direction());
+            if (scatter_pdf > 0)
+                emitted *= scatter_pdf / (scatter_pdf + light_pdf);
+            else if (light_pdf > 0)
+                emitted = Color(0, 0, 0);
+        }
+        radiance += throughput * emitted;
 
-//    hittable_pdf light_pdf(lights, rec.p);
-//    scattered = Ray(rec.p, light_pdf.generate(), r.time());
-//    pdf_val = light_pdf.value(scattered.direction());
+        // 击中自发光材质
+        skip_to_dimension(dim + dim_scatter);
+        if (!material_scatter(*rec.mat_ptr, r, rec, srec))
+            break;
 
-//    auto p0 = make_shared<hittable_pdf>(lights, rec.p);
-//    auto p1 = make_shared<cosine_pdf>(rec.normal);
-//    mixture_pdf mixed_pdf(p0, p1);
-//    scattered = Ray(rec.p, mixed_pdf.generate(), r.time());
-//    pdf_val = mixed_pdf.value(scattered.direction());
+        // 下一条射线和这次弹射的权重 f * cos / pdf
+        Ray scattered;
+        Color beta;
+        if (srec.is_specular) {
+            // 击中镜面材质
+            scattered = srec.specular_ray;
+            beta = srec.attenuation;
+            scatter_pdf = 0;
+        } else if (fog && rec.mat_ptr == fog->phase_function.get()) {
+            // 全局雾中的散射点：直接光已经由 fog_inscatter 计入，只继续弹射
+            skip_to_dimension(dim + dim_bsdf);
+            scattered = Ray(rec.p, srec.sample_pdf.generate(), r.time());
+            auto pdf_val = srec.sample_pdf.value(scattered.direction());
+            beta = srec.attenuation * material_scattering_pdf(*rec.mat_ptr, r, rec, scattered) / pdf_val;
+            scatter_pdf = -1;
+        } else {
+            // 直接光：阴影射线穿过介质，只被表面挡住
+            skip_to_dimension(dim + dim_light);
+            hittable_pdf light_pdf(lights, rec.p);
+            Ray shadow = rec.spawn_ray(light_pdf.generate(), r.time());
+            auto light_val = light_pdf.value(shadow.direction());
+            hit_record light_rec;
+            if (light_val > 0)
+                shadow_rays++;
+            if (light_val > 0 && world.scene::hit_surface(shadow, 0, infinity, light_rec)) {
+                auto light_emitted = material_emitted(*light_rec.mat_ptr, shadow, light_rec, light_rec.u, light_rec.v,
+                                                      light_rec.p);
+                if (!light_emitted.near_zero()) {
+                    auto weight = light_val / (light_val + srec.sample_pdf.value(shadow.direction()));
+                    radiance += throughput * weight * srec.attenuation
+                                * material_scattering_pdf(*rec.mat_ptr, r, rec, shadow) * light_emitted
+                                * world.scene::transmittance(shadow, 0, light_rec.t) / light_val;
+                }
+            }
 
-    scatter_record srec;
-    Color emitted = rec.mat_ptr->emitted(r, rec, rec.u, rec.v, rec.p);  // 自发光颜色
+            skip_to_dimension(dim + dim_bsdf);
+            scattered = rec.spawn_ray(srec.sample_pdf.generate(), r.time()); // 散播射线
+            auto pdf_val = srec.sample_pdf.value(scattered.direction());
+            if (pdf_val <= 0)
+                break;
 
-    // 击中自发光材质
-    if (!rec.mat_ptr->scatter(r, rec, srec)) {
-        return emitted;
-    }
+            // 光线能量按材质内表面或外表面的衰减值衰减；表现为：随着弹射次数的增加，在最终颜色值中的叠加权重降低
+            beta = srec.attenuation * material_scattering_pdf(*rec.mat_ptr, r, rec, scattered) / pdf_val;
+            scatter_pdf = pdf_val;
+        }
 
-    // 击中镜面材质
-    if (srec.is_specular) {
-        return srec.attenuation * ray_color(srec.specular_ray, background, world, lights, depth - 1);
+        auto survival = roulette_survival(throughput * beta, bounce, dim);
+        if (survival == 0)
+            break;
+        throughput = throughput * beta / survival;
+        r = scattered;
     }
 
-    auto light_ptr = make_shared<hittable_pdf>(lights, rec.p);
-    mixture_pdf p(light_ptr, srec.pdf_ptr);
+    return radiance;
+}
 
-    Ray scattered = Ray(rec.p, p.generate(), r.time()); // 散播射线
-    auto pdf_val = p.value(scattered.direction());
+const char *file_name = "image.ppm";
 
-    // 使用受击材质的属性为它们赋值，然后继续散播
-    // 递归，光线能量按材质内表面或外表面的衰减值衰减；表现为：随着弹射次数的增加，在最终颜色值中的叠加权重降低
-    return emitted + srec.attenuation * rec.mat_ptr->scattering_pdf(r, rec, scattered) * ray_color(scattered, background, world, lights, depth - 1) / pdf_val;
+// 输出 sphere_set 每个球占用的内存
+void print_sphere_set_stats(const sphere_set &set) {
+    std::cerr << "sphere_set: " << set.size() << " spheres, "
+              << double(set.sphere_bytes()) / set.size() << " B/sphere + "
+              << double(set.bvh_bytes()) / set.size() << " B/sphere BVH\n";
 }
 
-const char *file_name = "image.ppm";
+// 输出网格的读取时间和每个三角形占用的内存
+void print_mesh_stats(const triangle_mesh &mesh, double load_seconds) {
+    const auto n = static_cast<double>(mesh.triangle_count());
+    std::cerr << "mesh: " << mesh.triangle_count() << " triangles, " << mesh.vertex_count() << " vertices, load = "
+              << load_seconds << "s (" << n / load_seconds / 1e6 << " M triangles/s), "
+              << mesh.mesh_bytes() / n << " B/triangle + " << mesh.packed_bytes() / n << " B/triangle packed + "
+              << mesh.bvh_bytes() / n << " B/triangle BVH\n";
+}
 
 /// 随机场景
 hittable_list random_scene() {
     hittable_list world;
 
-    auto ground_material = make_shared<lambertian>(Color(0.8, 0.8, 0.0));
+    auto ground_material = arena_make_shared<lambertian>(Color(0.8, 0.8, 0.0));
 
 //    // Plane
 //    world.add(make_shared<Sphere>(Point3(0, -1000, 0), 1000, ground_material));
-    auto checker = make_shared<checker_texture>(Color(0.1, 0.1, 0.1), Color(0.9, 0.9, 0.9));
-    world.add(make_shared<Sphere>(Point3(0, -1000, 0), 1000, make_shared<lambertian>(checker)));
+    auto checker = arena_make_shared<checker_texture>(Color(0.1, 0.1, 0.1), Color(0.9, 0.9, 0.9));
+    world.add(arena_make_shared<Sphere>(Point3(0, -1000, 0), 1000, arena_make_shared<lambertian>(checker)));
+
+    // 网格中的静止小球放进一个 sphere_set
+    auto small_spheres = arena_make_shared<sphere_set>();
 
     for (int a = -11; a < 11; a++) {
         for (int b = -11; b < 11; b++) {
@@ -140,44 +337,47 @@ hittable_list random_scene() {
                 if (choose_mat < 0.8) {
                     // diffuse
                     auto albedo = Color::random() * Color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
+                    sphere_material = arena_make_shared<lambertian>(albedo);
                     auto center2 = center + Vec3(0, random_double(0, 0.5), 0);
-                    world.add(make_shared<moving_sphere>(center, center2, 0.0, 1.0, 0.2, sphere_material));
+                    world.add(arena_make_shared<moving_sphere>(center, center2, 0.0, 1.0, 0.2, sphere_material));
                 } else if (choose_mat < 0.95) {
                     // metal
                     auto albedo = Color::random(0.5, 1);
                     auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    world.add(make_shared<Sphere>(center, 0.2, sphere_material));
+                    sphere_material = arena_make_shared<metal>(albedo, fuzz);
+                    small_spheres->add(center, 0.2, sphere_material);
                 } else {
                     // glass
-                    sphere_material = make_shared<dielectric>(1.5);
-                    world.add(make_shared<Sphere>(center, 0.2, sphere_material));
+                    sphere_material = arena_make_shared<dielectric>(1.5);
+                    small_spheres->add(center, 0.2, sphere_material);
                 }
             }
         }
     }
+    small_spheres->build();
+    print_sphere_set_stats(*small_spheres);
+    world.add(small_spheres);
 
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<Sphere>(Point3(0, 1, 0), 1.0, material1));
+    auto material1 = arena_make_shared<dielectric>(1.5);
+    world.add(arena_make_shared<Sphere>(Point3(0, 1, 0), 1.0, material1));
 
-    auto material2 = make_shared<lambertian>(Color(0.4, 0.2, 0.1));
-    world.add(make_shared<Sphere>(Point3(-4, 1, 0), 1.0, material2));
+    auto material2 = arena_make_shared<lambertian>(Color(0.4, 0.2, 0.1));
+    world.add(arena_make_shared<Sphere>(Point3(-4, 1, 0), 1.0, material2));
 
-    auto material3 = make_shared<metal>(Color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<Sphere>(Point3(4, 1, 0), 1.0, material3));
+    auto material3 = arena_make_shared<metal>(Color(0.7, 0.6, 0.5), 0.0);
+    world.add(arena_make_shared<Sphere>(Point3(4, 1, 0), 1.0, material3));
 
-    return hittable_list(make_shared<bvh_node>(world, 0.0, 1.0));
+    return hittable_list(arena_make_shared<bvh_node>(world, 0.0, 1.0));
     return world;
 }
 
 hittable_list two_spheres() {
     hittable_list objects;
 
-    auto checker = make_shared<checker_texture>(Color(0.1, 0.1, 0.1), Color(0.9, 0.9, 0.9));
+    auto checker = arena_make_shared<checker_texture>(Color(0.1, 0.1, 0.1), Color(0.9, 0.9, 0.9));
 
-    objects.add(make_shared<Sphere>(Point3(0, -10, 0), 10, make_shared<lambertian>(checker)));
-    objects.add(make_shared<Sphere>(Point3(0, 10, 0), 10, make_shared<lambertian>(checker)));
+    objects.add(arena_make_shared<Sphere>(Point3(0, -10, 0), 10, arena_make_shared<lambertian>(checker)));
+    objects.add(arena_make_shared<Sphere>(Point3(0, 10, 0), 10, arena_make_shared<lambertian>(checker)));
 
     return objects;
 }
@@ -185,17 +385,17 @@ hittable_list two_spheres() {
 hittable_list two_perlin_sphere() {
     hittable_list objects;
 
-    auto pertext = make_shared<noise_texture>(4);
-    objects.add(make_shared<Sphere>(Point3(0, -1000, 0), 1000, make_shared<lambertian>(pertext)));
-    objects.add(make_shared<Sphere>(Point3(0, 2, 0), 2, make_shared<lambertian>(pertext)));
+    auto pertext = arena_make_shared<noise_texture>(4);
+    objects.add(arena_make_shared<Sphere>(Point3(0, -1000, 0), 1000, arena_make_shared<lambertian>(pertext)));
+    objects.add(arena_make_shared<Sphere>(Point3(0, 2, 0), 2, arena_make_shared<lambertian>(pertext)));
 
     return objects;
 }
 
 hittable_list earth() {
-    auto earth_texture = make_shared<image_texture>("Image/latlon-base-map.png");
-    auto earth_surface = make_shared<lambertian>(earth_texture);
-    auto globe = make_shared<Sphere>(Point3(0, 0, 0), 2, earth_surface);
+    auto earth_texture = arena_make_shared<image_texture>("Image/latlon-base-map.png");
+    auto earth_surface = arena_make_shared<lambertian>(earth_texture);
+    auto globe = arena_make_shared<Sphere>(Point3(0, 0, 0), 2, earth_surface);
 
     return hittable_list(globe);
 }
@@ -203,13 +403,13 @@ hittable_list earth() {
 hittable_list simple_light() {
     hittable_list objects;
 
-    auto pertext = make_shared<noise_texture>(4);
-    objects.add(make_shared<Sphere>(Point3(0, -1000, 0), 1000, make_shared<lambertian>(pertext)));
-    objects.add(make_shared<Sphere>(Point3(0, 2, 0), 2, make_shared<lambertian>(pertext)));
+    auto pertext = arena_make_shared<noise_texture>(4);
+    objects.add(arena_make_shared<Sphere>(Point3(0, -1000, 0), 1000, arena_make_shared<lambertian>(pertext)));
+    objects.add(arena_make_shared<Sphere>(Point3(0, 2, 0), 2, arena_make_shared<lambertian>(pertext)));
 
-    auto difflight = make_shared<diffuse_light>(Color(4, 4, 4));
-    objects.add(make_shared<Sphere>(Point3(0, 7, 0), 2, difflight));
-    objects.add(make_shared<xy_rect>(3, 5, 1, 3, -2, difflight));
+    auto difflight = arena_make_shared<diffuse_light>(Color(4, 4, 4));
+    objects.add(arena_make_shared<Sphere>(Point3(0, 7, 0), 2, difflight));
+    objects.add(arena_make_shared<xy_rect>(3, 5, 1, 3, -2, difflight));
 
     return objects;
 }
@@ -217,27 +417,27 @@ hittable_list simple_light() {
 hittable_list cornell_box() {
     hittable_list objects;
 
-    auto red = make_shared<lambertian>(Color(.65, .05, .05));
-    auto white = make_shared<lambertian>(Color(.73, .73, .73));
-    auto green = make_shared<lambertian>(Color(.12, .45, .15));
-    auto light = make_shared<diffuse_light>(Color(15, 15, 15));
+    auto red = arena_make_shared<lambertian>(Color(.65, .05, .05));
+    auto white = arena_make_shared<lambertian>(Color(.73, .73, .73));
+    auto green = arena_make_shared<lambertian>(Color(.12, .45, .15));
+    auto light = arena_make_shared<diffuse_light>(Color(15, 15, 15));
 
-    objects.add(make_shared<yz_rect>(0, 555, 0, 555, 555, green));
-    objects.add(make_shared<yz_rect>(0, 555, 0, 555, 0, red));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 555, green));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 0, red));
 
     // objects.add(make_shared<xz_rect>(213, 343, 227, 332, 554, light));
-    objects.add(make_shared<flip_face>(make_shared<xz_rect>(213, 343, 227, 332, 554, light)));
+    objects.add(arena_make_shared<flip_face>(arena_make_shared<xz_rect>(213, 343, 227, 332, 554, light)));
 
-    objects.add(make_shared<xz_rect>(0, 555, 0, 555, 0, white));
-    objects.add(make_shared<xz_rect>(0, 555, 0, 555, 555, white));
-    objects.add(make_shared<xy_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 0, white));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<xy_rect>(0, 555, 0, 555, 555, white));
 
 //    shared_ptr<material> aluminum = make_shared<metal>(Color(0.8, 0.85, 0.88), 0.0);
 //    shared_ptr<hittable> box1 = make_shared<box>(Point3(0, 0, 0), Point3(165, 330, 165), aluminum);
 
-    shared_ptr<hittable> box1 = make_shared<box>(Point3(0, 0, 0), Point3(165, 330, 165), white);
-    box1 = make_shared<rotate_y>(box1, 15);
-    box1 = make_shared<translate>(box1, Vec3(265, 0, 295));
+    shared_ptr<hittable> box1 = arena_make_shared<box>(Point3(0, 0, 0), Point3(165, 330, 165), white);
+    box1 = arena_make_shared<rotate_y>(box1, 15);
+    box1 = arena_make_shared<translate>(box1, Vec3(265, 0, 295));
     objects.add(box1);
 
 //    shared_ptr<hittable> box2 = make_shared<box>(Point3(0, 0, 0), Point3(165, 165, 165), white);
@@ -246,7 +446,7 @@ hittable_list cornell_box() {
 //    objects.add(box2);
 
 //    auto glass = make_shared<dielectric>(1.5);
-    objects.add(make_shared<Sphere>(Point3(190, 90, 190), 90 , white));
+    objects.add(arena_make_shared<Sphere>(Point3(190, 90, 190), 90 , white));
 
     return objects;
 }
@@ -254,28 +454,28 @@ hittable_list cornell_box() {
 hittable_list cornell_smoke() {
     hittable_list objects;
 
-    auto red = make_shared<lambertian>(Color(.65, .05, .05));
-    auto white = make_shared<lambertian>(Color(.73, .73, .73));
-    auto green = make_shared<lambertian>(Color(.12, .45, .15));
-    auto light = make_shared<diffuse_light>(Color(7, 7, 7));
+    auto red = arena_make_shared<lambertian>(Color(.65, .05, .05));
+    auto white = arena_make_shared<lambertian>(Color(.73, .73, .73));
+    auto green = arena_make_shared<lambertian>(Color(.12, .45, .15));
+    auto light = arena_make_shared<diffuse_light>(Color(7, 7, 7));
 
-    objects.add(make_shared<yz_rect>(0, 555, 0, 555, 555, green));
-    objects.add(make_shared<yz_rect>(0, 555, 0, 555, 0, red));
-    objects.add(make_shared<xz_rect>(113, 443, 127, 432, 554, light));
-    objects.add(make_shared<xz_rect>(0, 555, 0, 555, 0, white));
-    objects.add(make_shared<xz_rect>(0, 555, 0, 555, 555, white));
-    objects.add(make_shared<xy_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 555, green));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 0, red));
+    objects.add(arena_make_shared<xz_rect>(113, 443, 127, 432, 554, light));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 0, white));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<xy_rect>(0, 555, 0, 555, 555, white));
 
-    shared_ptr<hittable> box1 = make_shared<box>(Point3(0, 0, 0), Point3(165, 330, 165), white);
-    box1 = make_shared<rotate_y>(box1, 15);
-    box1 = make_shared<translate>(box1, Vec3(265, 0, 295));
+    shared_ptr<hittable> box1 = arena_make_shared<box>(Point3(0, 0, 0), Point3(165, 330, 165), white);
+    box1 = arena_make_shared<rotate_y>(box1, 15);
+    box1 = arena_make_shared<translate>(box1, Vec3(265, 0, 295));
 
-    shared_ptr<hittable> box2 = make_shared<box>(Point3(0, 0, 0), Point3(165, 165, 165), white);
-    box2 = make_shared<rotate_y>(box2, -18);
-    box2 = make_shared<translate>(box2, Vec3(130, 0, 65));
+    shared_ptr<hittable> box2 = arena_make_shared<box>(Point3(0, 0, 0), Point3(165, 165, 165), white);
+    box2 = arena_make_shared<rotate_y>(box2, -18);
+    box2 = arena_make_shared<translate>(box2, Vec3(130, 0, 65));
 
-    objects.add(make_shared<constant_medium>(box1, 0.05, Color(0, 0, 0)));
-    objects.add(make_shared<constant_medium>(box2, 0.05, Color(1, 1, 1)));
+    objects.add(arena_make_shared<constant_medium>(box1, 0.05, Color(0, 0, 0)));
+    objects.add(arena_make_shared<constant_medium>(box2, 0.05, Color(1, 1, 1)));
 
     return objects;
 }
@@ -286,28 +486,28 @@ hittable_list cornell_box_cover1() {
     file_name = "cornell_box_cover1.ppm";
     hittable_list objects;
 
-    auto red = make_shared<lambertian>(Color(.65, .05, .05));
-    auto white = make_shared<lambertian>(Color(.73, .73, .73));
-    auto green = make_shared<lambertian>(Color(.12, .45, .15));
-    auto light = make_shared<diffuse_light>(Color(15, 15, 15));
+    auto red = arena_make_shared<lambertian>(Color(.65, .05, .05));
+    auto white = arena_make_shared<lambertian>(Color(.73, .73, .73));
+    auto green = arena_make_shared<lambertian>(Color(.12, .45, .15));
+    auto light = arena_make_shared<diffuse_light>(Color(15, 15, 15));
 
-    objects.add(make_shared<yz_rect>(0, 555, 0, 555, 555, green));
-    objects.add(make_shared<yz_rect>(0, 555, 0, 555, 0, red));
-    objects.add(make_shared<xz_rect>(213, 343, 227, 332, 554, light));
-    objects.add(make_shared<xz_rect>(0, 555, 0, 555, 0, white));
-    objects.add(make_shared<xz_rect>(0, 555, 0, 555, 555, white));
-    objects.add(make_shared<xy_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 555, green));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 0, red));
+    objects.add(arena_make_shared<xz_rect>(213, 343, 227, 332, 554, light));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 0, white));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<xy_rect>(0, 555, 0, 555, 555, white));
 
     // 金属立方体
-    shared_ptr<material> aluminum = make_shared<metal>(Color(0.8, 0.85, 0.88), 0.3);
-    shared_ptr<hittable> box1 = make_shared<box>(Point3(0, 0, 0), Point3(165, 330, 165), aluminum);
-    box1 = make_shared<rotate_y>(box1, 15);
-    box1 = make_shared<translate>(box1, Vec3(265, 0, 295));
+    shared_ptr<material> aluminum = arena_make_shared<metal>(Color(0.8, 0.85, 0.88), 0.3);
+    shared_ptr<hittable> box1 = arena_make_shared<box>(Point3(0, 0, 0), Point3(165, 330, 165), aluminum);
+    box1 = arena_make_shared<rotate_y>(box1, 15);
+    box1 = arena_make_shared<translate>(box1, Vec3(265, 0, 295));
     objects.add(box1);
 
     // 玻璃球
-    auto glass = make_shared<dielectric>(1.5);
-    objects.add(make_shared<Sphere>(Point3(190, 90, 190), 90, glass));
+    auto glass = arena_make_shared<dielectric>(1.5);
+    objects.add(arena_make_shared<Sphere>(Point3(190, 90, 190), 90, glass));
 
     return objects;
 }
@@ -318,28 +518,28 @@ hittable_list cornell_box_cover2() {
     file_name = "cornell_box_cover2.ppm";
     hittable_list objects;
 
-    auto red = make_shared<lambertian>(Color(.65, .05, .05));
-    auto white = make_shared<lambertian>(Color(.73, .73, .73));
-    auto green = make_shared<lambertian>(Color(.12, .45, .15));
-    auto light = make_shared<diffuse_light>(Color(15, 15, 15));
+    auto red = arena_make_shared<lambertian>(Color(.65, .05, .05));
+    auto white = arena_make_shared<lambertian>(Color(.73, .73, .73));
+    auto green = arena_make_shared<lambertian>(Color(.12, .45, .15));
+    auto light = arena_make_shared<diffuse_light>(Color(15, 15, 15));
 
-    objects.add(make_shared<yz_rect>(0, 555, 0, 555, 555, green));
-    objects.add(make_shared<yz_rect>(0, 555, 0, 555, 0, red));
-    objects.add(make_shared<xz_rect>(213, 343, 227, 332, 554, light));
-    objects.add(make_shared<xz_rect>(0, 555, 0, 555, 0, white));
-    objects.add(make_shared<xz_rect>(0, 555, 0, 555, 555, white));
-    objects.add(make_shared<xy_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 555, green));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 0, red));
+    objects.add(arena_make_shared<xz_rect>(213, 343, 227, 332, 554, light));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 0, white));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<xy_rect>(0, 555, 0, 555, 555, white));
 
     // 白雾玻璃立方体
-    shared_ptr<hittable> box1 = make_shared<box>(Point3(0, 0, 0), Point3(165, 330, 165), make_shared<dielectric>(1.5));
-    box1 = make_shared<rotate_y>(box1, 15);
-    box1 = make_shared<translate>(box1, Vec3(265, 0, 295));
+    shared_ptr<hittable> box1 = arena_make_shared<box>(Point3(0, 0, 0), Point3(165, 330, 165), arena_make_shared<dielectric>(1.5));
+    box1 = arena_make_shared<rotate_y>(box1, 15);
+    box1 = arena_make_shared<translate>(box1, Vec3(265, 0, 295));
     objects.add(box1);
-    objects.add(make_shared<constant_medium>(box1, 0.1, Color(.73, .73, .73)));
+    objects.add(arena_make_shared<constant_medium>(box1, 0.1, Color(.73, .73, .73)));
 
     // 大理石球
-    auto pertext = make_shared<noise_texture>(0.05);
-    objects.add(make_shared<Sphere>(Point3(190, 90, 190), 90, make_shared<lambertian>(pertext)));
+    auto pertext = arena_make_shared<noise_texture>(0.05);
+    objects.add(arena_make_shared<Sphere>(Point3(190, 90, 190), 90, arena_make_shared<lambertian>(pertext)));
 
     return objects;
 }
@@ -350,38 +550,39 @@ hittable_list cornell_box_cover3() {
     file_name = "cornell_box_cover3.ppm";
     hittable_list objects;
 
-    auto red = make_shared<lambertian>(Color(.65, .05, .05));
-    auto white = make_shared<lambertian>(Color(.73, .73, .73));
-    auto green = make_shared<lambertian>(Color(.12, .45, .15));
-    auto light = make_shared<diffuse_light>(Color(15, 15, 15));
+    auto red = arena_make_shared<lambertian>(Color(.65, .05, .05));
+    auto white = arena_make_shared<lambertian>(Color(.73, .73, .73));
+    auto green = arena_make_shared<lambertian>(Color(.12, .45, .15));
+    auto light = arena_make_shared<diffuse_light>(Color(15, 15, 15));
 
-    objects.add(make_shared<yz_rect>(0, 555, 0, 555, 555, green));
-    objects.add(make_shared<yz_rect>(0, 555, 0, 555, 0, red));
-    objects.add(make_shared<xz_rect>(213, 343, 227, 332, 554, light));
-    objects.add(make_shared<xz_rect>(0, 555, 0, 555, 0, white));
-    objects.add(make_shared<xz_rect>(0, 555, 0, 555, 555, white));
-    objects.add(make_shared<xy_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 555, green));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 0, red));
+    objects.add(arena_make_shared<xz_rect>(213, 343, 227, 332, 554, light));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 0, white));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<xy_rect>(0, 555, 0, 555, 555, white));
 
     // 聚集方块
-    hittable_list boxes;
+    auto boxes = arena_make_shared<sphere_set>();
     int ns = 4000;
     for (int j = 0; j < ns; j++) {
-        boxes.add(make_shared<Sphere>(Point3(
+        boxes->add(Point3(
                 random_double(0.0, 165.0),
                 random_double(0.0, 330.0),
-                random_double(0.0, 165.0)), 10, white));
+                random_double(0.0, 165.0)), 10, white);
     }
-    objects.add(make_shared<translate>(
-                        make_shared<rotate_y>(
-                                make_shared<bvh_node>(boxes, 0.0, 1.0), 15),
+    boxes->build();
+    print_sphere_set_stats(*boxes);
+    objects.add(arena_make_shared<translate>(
+                        arena_make_shared<rotate_y>(boxes, 15),
                         Vec3(265, 0, 295)
                 )
     );
 
     // 雾玻璃球
-    auto boundary = make_shared<Sphere>(Point3(190, 90, 190), 90, make_shared<dielectric>(1.5));
+    auto boundary = arena_make_shared<Sphere>(Point3(190, 90, 190), 90, arena_make_shared<dielectric>(1.5));
     objects.add(boundary);
-    objects.add(make_shared<constant_medium>(boundary, 0.2, Color(0.2, 0.4, 0.9)));
+    objects.add(arena_make_shared<constant_medium>(boundary, 0.2, Color(0.2, 0.4, 0.9)));
 
     return objects;
 }
@@ -392,7 +593,7 @@ hittable_list final_scene() {
 
     // 地面
     hittable_list boxes1;
-    auto ground = make_shared<lambertian>(Color(0.48, 0.83, 0.53));
+    auto ground = arena_make_shared<lambertian>(Color(0.48, 0.83, 0.53));
     const int boxes_per_side = 20;
     for (int i = 0; i < boxes_per_side; ++i) {
         for (int j = 0; j < boxes_per_side; ++j) {
@@ -404,54 +605,55 @@ hittable_list final_scene() {
             auto y1 = random_double(1, 101);
             auto z1 = z0 + w;
 
-            boxes1.add(make_shared<box>(Point3(x0, y0, z0), Point3(x1, y1, z1), ground));
+            boxes1.add(arena_make_shared<box>(Point3(x0, y0, z0), Point3(x1, y1, z1), ground));
         }
     }
-    objects.add(make_shared<bvh_node>(boxes1, 0, 1));
+    objects.add(arena_make_shared<bvh_node>(boxes1, 0, 1));
 
     // 顶灯
-    auto light = make_shared<diffuse_light>(Color(7, 7, 7));
-    objects.add(make_shared<xz_rect>(123, 423, 147, 412, 554, light));
+    auto light = arena_make_shared<diffuse_light>(Color(7, 7, 7));
+    objects.add(arena_make_shared<xz_rect>(123, 423, 147, 412, 554, light));
 
     // 运动球
     auto center1 = Point3(400, 400, 200);
     auto center2 = center1 + Vec3(30, 0, 0);
-    auto moving_sphere_material = make_shared<lambertian>(Color(0.7, 0.3, 0.1));
-    objects.add(make_shared<moving_sphere>(center1, center2, 0, 1, 50, moving_sphere_material));
+    auto moving_sphere_material = arena_make_shared<lambertian>(Color(0.7, 0.3, 0.1));
+    objects.add(arena_make_shared<moving_sphere>(center1, center2, 0, 1, 50, moving_sphere_material));
 
     // 玻璃球
-    objects.add(make_shared<Sphere>(Point3(260, 150, 45), 50, make_shared<dielectric>(1.5)));
+    objects.add(arena_make_shared<Sphere>(Point3(260, 150, 45), 50, arena_make_shared<dielectric>(1.5)));
 
     // 金属球(右)
-    objects.add(make_shared<Sphere>(Point3(0, 150, 145), 50, make_shared<metal>(Color(0.8, 0.8, 0.9), 1.0)));
+    objects.add(arena_make_shared<Sphere>(Point3(0, 150, 145), 50, arena_make_shared<metal>(Color(0.8, 0.8, 0.9), 1.0)));
 
     // 蓝色玻璃球
-    auto boundary = make_shared<Sphere>(Point3(360, 150, 145), 70, make_shared<dielectric>(1.5));
+    auto boundary = arena_make_shared<Sphere>(Point3(360, 150, 145), 70, arena_make_shared<dielectric>(1.5));
     objects.add(boundary);
-    objects.add(make_shared<constant_medium>(boundary, 0.2, Color(0.2, 0.4, 0.9)));
+    objects.add(arena_make_shared<constant_medium>(boundary, 0.2, Color(0.2, 0.4, 0.9)));
 
     // 全局雾
-    boundary = make_shared<Sphere>(Point3(0, 0, 0), 5000, make_shared<dielectric>(1.5));
-    objects.add(make_shared<constant_medium>(boundary, .0001, Color(1, 1, 1)));
+    boundary = arena_make_shared<Sphere>(Point3(0, 0, 0), 5000, arena_make_shared<dielectric>(1.5));
+    objects.add(arena_make_shared<constant_medium>(boundary, .0001, Color(1, 1, 1)));
 
     // 贴图纹理球
-    auto emat = make_shared<lambertian>(make_shared<image_texture>("Image/latlon-base-map.png"));
-    objects.add(make_shared<Sphere>(Point3(400, 200, 400), 100, emat));
+    auto emat = arena_make_shared<lambertian>(arena_make_shared<image_texture>("Image/latlon-base-map.png"));
+    objects.add(arena_make_shared<Sphere>(Point3(400, 200, 400), 100, emat));
 
     // 噪声纹理球
-    auto pertext = make_shared<noise_texture>(0.1);
-    objects.add(make_shared<Sphere>(Point3(220, 280, 300), 80, make_shared<lambertian>(pertext)));
+    auto pertext = arena_make_shared<noise_texture>(0.1);
+    objects.add(arena_make_shared<Sphere>(Point3(220, 280, 300), 80, arena_make_shared<lambertian>(pertext)));
 
     // 聚集方块
-    hittable_list boxes2;
-    auto white = make_shared<lambertian>(Color(.73, .73, .73));
+    auto boxes2 = arena_make_shared<sphere_set>();
+    auto white = arena_make_shared<lambertian>(Color(.73, .73, .73));
     int ns = 1000;
     for (int j = 0; j < ns; j++) {
-        boxes2.add(make_shared<Sphere>(Point3::random(0, 165), 10, white));
+        boxes2->add(Point3::random(0, 165), 10, white);
     }
-    objects.add(make_shared<translate>(
-                        make_shared<rotate_y>(
-                                make_shared<bvh_node>(boxes2, 0.0, 1.0), 15),
+    boxes2->build();
+    print_sphere_set_stats(*boxes2);
+    objects.add(arena_make_shared<translate>(
+                        arena_make_shared<rotate_y>(boxes2, 15),
                         Vec3(-100, 270, 395)
                 )
     );
@@ -463,10 +665,10 @@ hittable_list final_scene2() {
 
     hittable_list world;
 
-    auto ground_material = make_shared<lambertian>(Color(0.8, 0.8, 0.0));
+    auto ground_material = arena_make_shared<lambertian>(Color(0.8, 0.8, 0.0));
 
     // Plane
-    world.add(make_shared<Sphere>(Point3(0, -1000, 0), 1000, ground_material));
+    world.add(arena_make_shared<Sphere>(Point3(0, -1000, 0), 1000, ground_material));
 
     // 小球
     hittable_list boxes1;
@@ -481,52 +683,52 @@ hittable_list final_scene2() {
                 if (choose_mat < 0.8) {
                     // diffuse
                     auto albedo = Color::random() * Color::random();
-                    sphere_material = make_shared<lambertian>(albedo);
+                    sphere_material = arena_make_shared<lambertian>(albedo);
                     auto center2 = center + Vec3(0, random_double(0, 0.5), 0);
                     if (choose_mat < 0.75) {
-                        boxes1.add(make_shared<Sphere>(center, 0.2, sphere_material));
+                        boxes1.add(arena_make_shared<Sphere>(center, 0.2, sphere_material));
                     } else {
-                        boxes1.add(make_shared<moving_sphere>(center, center2, 0.0, 1.0, 0.2, sphere_material));
+                        boxes1.add(arena_make_shared<moving_sphere>(center, center2, 0.0, 1.0, 0.2, sphere_material));
                     }
                 } else if (choose_mat < 0.95) {
                     // metal
                     auto albedo = Color::random(0.5, 1);
                     auto fuzz = random_double(0, 0.5);
-                    sphere_material = make_shared<metal>(albedo, fuzz);
-                    boxes1.add(make_shared<Sphere>(center, 0.2, sphere_material));
+                    sphere_material = arena_make_shared<metal>(albedo, fuzz);
+                    boxes1.add(arena_make_shared<Sphere>(center, 0.2, sphere_material));
                 } else {
                     // glass
-                    sphere_material = make_shared<dielectric>(1.5);
-                    boxes1.add(make_shared<Sphere>(center, 0.2, sphere_material));
+                    sphere_material = arena_make_shared<dielectric>(1.5);
+                    boxes1.add(arena_make_shared<Sphere>(center, 0.2, sphere_material));
                 }
             }
         }
     }
-    world.add(make_shared<bvh_node>(boxes1, 0, 1));
+    world.add(arena_make_shared<bvh_node>(boxes1, 0, 1));
 
 
-    auto material1 = make_shared<dielectric>(1.5);
-    world.add(make_shared<Sphere>(Point3(0, 1, 0), 1.0, material1));
+    auto material1 = arena_make_shared<dielectric>(1.5);
+    world.add(arena_make_shared<Sphere>(Point3(0, 1, 0), 1.0, material1));
 
 //    auto material2 = make_shared<lambertian>(make_shared<image_texture>("Image/marsmap.jpg"));
 //    world.add(make_shared<Sphere>(Point3(-4, 1, 0), 1.0, material2));
 
-    auto pertext = make_shared<noise_texture>(0.1);
-    world.add(make_shared<Sphere>(Point3(-4, 1, 0), 1.0, make_shared<lambertian>(pertext)));
+    auto pertext = arena_make_shared<noise_texture>(0.1);
+    world.add(arena_make_shared<Sphere>(Point3(-4, 1, 0), 1.0, arena_make_shared<lambertian>(pertext)));
 
-    auto material3 = make_shared<metal>(Color(0.7, 0.6, 0.5), 0.0);
-    world.add(make_shared<Sphere>(Point3(4, 1, 0), 1.0, material3));
+    auto material3 = arena_make_shared<metal>(Color(0.7, 0.6, 0.5), 0.0);
+    world.add(arena_make_shared<Sphere>(Point3(4, 1, 0), 1.0, material3));
 
     // 灯
-    auto light = make_shared<diffuse_light>(Color(7, 7, 7));
-    world.add(make_shared<Sphere>(Point3(0, 4, 0), 1.0, light));
+    auto light = arena_make_shared<diffuse_light>(Color(7, 7, 7));
+    world.add(arena_make_shared<Sphere>(Point3(0, 4, 0), 1.0, light));
 
 //    auto light = make_shared<diffuse_light>(Color(7, 7, 7));
 //    world.add(make_shared<xz_rect>(-5, 5, -0.5, 0.5, 4, light));
 
     // 全局雾
-    auto boundary = make_shared<Sphere>(Point3(0, 0, 0), 50, make_shared<dielectric>(1.5));
-    world.add(make_shared<constant_medium>(boundary, .0001, Color(1, 1, 1)));
+    auto boundary = arena_make_shared<Sphere>(Point3(0, 0, 0), 50, arena_make_shared<dielectric>(1.5));
+    world.add(arena_make_shared<constant_medium>(boundary, .0001, Color(1, 1, 1)));
 
     return world;
 }
@@ -534,77 +736,270 @@ hittable_list final_scene2() {
 hittable_list cornell_box_new() {
     hittable_list objects;
 
-    auto red = make_shared<lambertian>(Color(.65, .05, .05));
-    auto blue = make_shared<lambertian>(Color(.23, .23, .8));
-    auto white = make_shared<lambertian>(Color(1, 1, 1));
-    auto green = make_shared<lambertian>(Color(0.0, .63, 0.0));
+    auto red = arena_make_shared<lambertian>(Color(.65, .05, .05));
+    auto blue = arena_make_shared<lambertian>(Color(.23, .23, .8));
+    auto white = arena_make_shared<lambertian>(Color(1, 1, 1));
+    auto green = arena_make_shared<lambertian>(Color(0.0, .63, 0.0));
 
-    auto light_white = make_shared<diffuse_light>(Color(15, 15, 16));
-    auto light_blue = make_shared<diffuse_light>(Color(0.5, 9, 9));
-    auto light_yellow = make_shared<diffuse_light>(Color(9, 9, 0.5));
+    auto light_white = arena_make_shared<diffuse_light>(Color(15, 15, 16));
+    auto light_blue = arena_make_shared<diffuse_light>(Color(0.5, 9, 9));
+    auto light_yellow = arena_make_shared<diffuse_light>(Color(9, 9, 0.5));
 
-    objects.add(make_shared<yz_rect>(0, 555, 0, 555, 555, blue));
-    objects.add(make_shared<yz_rect>(0, 555, 0, 555, 0, green));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 555, blue));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 0, green));
 
     // objects.add(make_shared<xz_rect>(213, 343, 227, 332, 554, light_white));
-    objects.add(make_shared<flip_face>(make_shared<xz_rect>(213, 343, 227, 332, 554, light_white)));
-    objects.add(make_shared<flip_face>(make_shared<yz_rect>(35, 40, 0, 555, 554, light_blue)));
-    objects.add(make_shared<yz_rect>(110, 115, 0, 555, 1, light_yellow));
+    objects.add(arena_make_shared<flip_face>(arena_make_shared<xz_rect>(213, 343, 227, 332, 554, light_white)));
+    objects.add(arena_make_shared<flip_face>(arena_make_shared<yz_rect>(35, 40, 0, 555, 554, light_blue)));
+    objects.add(arena_make_shared<yz_rect>(110, 115, 0, 555, 1, light_yellow));
 
-    objects.add(make_shared<xz_rect>(0, 555, 0, 555, 0, white));
-    objects.add(make_shared<xz_rect>(0, 555, 0, 555, 555, white));
-    objects.add(make_shared<xy_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 0, white));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<xy_rect>(0, 555, 0, 555, 555, white));
 
-    shared_ptr<material> aluminum = make_shared<metal>(Color(0.8, 0.85, 0.88), 0.3);
-    shared_ptr<hittable> box1 = make_shared<box>(Point3(0, 0, 0), Point3(165, 330, 165), aluminum);
+    shared_ptr<material> aluminum = arena_make_shared<metal>(Color(0.8, 0.85, 0.88), 0.3);
+    shared_ptr<hittable> box1 = arena_make_shared<box>(Point3(0, 0, 0), Point3(165, 330, 165), aluminum);
 
 //    shared_ptr<hittable> box1 = make_shared<box>(Point3(0, 0, 0), Point3(165, 330, 165), white);
-    box1 = make_shared<rotate_y>(box1, 15);
-    box1 = make_shared<translate>(box1, Vec3(265, 0, 295));
+    box1 = arena_make_shared<rotate_y>(box1, 15);
+    box1 = arena_make_shared<translate>(box1, Vec3(265, 0, 295));
     objects.add(box1);
 
-    shared_ptr<hittable> box2 = make_shared<box>(Point3(0, 0, 0), Point3(165, 165, 165), white);
-    box2 = make_shared<rotate_y>(box2, -18);
-    box2 = make_shared<translate>(box2, Vec3(130, 0, 65));
+    shared_ptr<hittable> box2 = arena_make_shared<box>(Point3(0, 0, 0), Point3(165, 165, 165), white);
+    box2 = arena_make_shared<rotate_y>(box2, -18);
+    box2 = arena_make_shared<translate>(box2, Vec3(130, 0, 65));
     objects.add(box2);
 
 //    auto glass = make_shared<dielectric>(1.5);
 //    objects.add(make_shared<Sphere>(Point3(190, 165+80, 190), 80 , red));
 
-    auto boundary = make_shared<Sphere>(Point3(190, 165+80, 190), 80, make_shared<dielectric>(1.5));
+    auto boundary = arena_make_shared<Sphere>(Point3(190, 165+80, 190), 80, arena_make_shared<dielectric>(1.5));
     objects.add(boundary);
-    objects.add(make_shared<constant_medium>(boundary, 0.2, Color(1, 0, 0)));
+    objects.add(arena_make_shared<constant_medium>(boundary, 0.2, Color(1, 0, 0)));
 
     return objects;
 }
 
-int main() {
+// 把包围盒为 bounds 的物体缩放到 330 高，放在 Cornell box 地面中央
+transform cornell_box_placement(const aabb &bounds) {
+    auto extent = bounds.max() - bounds.min();
+    auto scale = 330 / fmax(extent.x(), fmax(extent.y(), extent.z()));
+    auto base = Point3(bounds.center().x(), bounds.min().y(), bounds.center().z());
+    return transform::translation(Vec3(278, 0, 278)) * transform::scaling(Vec3(scale, scale, scale))
+           * transform::translation(-base);
+}
+
+/// Cornell box 中放一个从 OBJ 文件读取的网格，缩放到 330 高，放在地面中央。quantize 为 true 时网格使用压缩存储
+hittable_list cornell_box_mesh(const char *filename, bool quantize) {
+    hittable_list objects;
+
+    auto red = arena_make_shared<lambertian>(Color(.65, .05, .05));
+    auto white = arena_make_shared<lambertian>(Color(.73, .73, .73));
+    auto green = arena_make_shared<lambertian>(Color(.12, .45, .15));
+    auto light = arena_make_shared<diffuse_light>(Color(15, 15, 15));
+
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 555, green));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 0, red));
+    objects.add(arena_make_shared<flip_face>(arena_make_shared<xz_rect>(213, 343, 227, 332, 554, light)));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 0, white));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<xy_rect>(0, 555, 0, 555, 555, white));
+
+    const clock_t load_start = clock();
+    auto mesh = load_obj(filename, white, quantize);
+    if (!mesh)
+        return objects;
+    print_mesh_stats(*mesh, double(clock() - load_start) / CLOCKS_PER_SEC);
+
+    aabb bounds;
+    if (!mesh->bounding_box(0, 1, bounds))
+        return objects;
+    objects.add(arena_make_shared<instance>(mesh, cornell_box_placement(bounds)));
+
+    return objects;
+}
+
+/// Cornell box 中放一个从点云文件 (二进制 PLY 或 float32 x, y, z) 读取的 sphere_set，摆放方式与网格相同
+hittable_list cornell_box_points(const char *filename) {
+    hittable_list objects;
+
+    auto red = arena_make_shared<lambertian>(Color(.65, .05, .05));
+    auto white = arena_make_shared<lambertian>(Color(.73, .73, .73));
+    auto green = arena_make_shared<lambertian>(Color(.12, .45, .15));
+    auto light = arena_make_shared<diffuse_light>(Color(15, 15, 15));
+
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 555, green));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 0, red));
+    objects.add(arena_make_shared<flip_face>(arena_make_shared<xz_rect>(213, 343, 227, 332, 554, light)));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 0, white));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<xy_rect>(0, 555, 0, 555, 555, white));
+
+    const clock_t load_start = clock();
+    auto points = load_point_cloud(filename, 0, white);
+    if (!points)
+        return objects;
+    const clock_t build_start = clock();
+    points->build();
+    const clock_t build_end = clock();
+    std::cerr << "point cloud: load = " << double(build_start - load_start) / CLOCKS_PER_SEC << "s, BVH build = "
+              << double(build_end - build_start) / CLOCKS_PER_SEC << "s\n";
+    print_sphere_set_stats(*points);
+
+    aabb bounds;
+    if (!points->bounding_box(0, 1, bounds))
+        return objects;
+    objects.add(arena_make_shared<instance>(points, cornell_box_placement(bounds)));
+
+    return objects;
+}
+
+/// Cornell box 中的一团非均匀烟雾 (体素网格)。voxel_file 为 "perlin" 时用 perlin 噪声生成，否则读取 n^3 个 float32 体素；
+/// march_step > 0 时用固定步长 ray marching 采样自由程，和 delta tracking 对照
+hittable_list cornell_grid_smoke(const char *voxel_file, real march_step) {
+    hittable_list objects;
+
+    auto red = arena_make_shared<lambertian>(Color(.65, .05, .05));
+    auto white = arena_make_shared<lambertian>(Color(.73, .73, .73));
+    auto green = arena_make_shared<lambertian>(Color(.12, .45, .15));
+    auto light = arena_make_shared<diffuse_light>(Color(15, 15, 15));
+
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 555, green));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 0, red));
+    objects.add(arena_make_shared<flip_face>(arena_make_shared<xz_rect>(213, 343, 227, 332, 554, light)));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 0, white));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<xy_rect>(0, 555, 0, 555, 555, white));
+
+    const aabb bounds(Point3(78, 40, 78), Point3(478, 440, 478));
+    const real density_scale = 0.05;
+    const Color albedo(.8, .8, .8);
+
+    shared_ptr<grid_medium> smoke;
+    if (std::string(voxel_file) != "perlin") {
+        // 文件大小决定立方体网格的分辨率
+        FILE *file = fopen(voxel_file, "rb");
+        long size = -1;
+        if (file) {
+            fseek(file, 0, SEEK_END);
+            size = ftell(file);
+            fclose(file);
+        }
+        auto n = static_cast<int>(std::round(std::cbrt(size / 4.0)));
+        smoke = load_grid_medium(voxel_file, n, n, n, bounds, density_scale, albedo);
+    } else {
+        smoke = perlin_grid_medium(128, bounds, density_scale, albedo);
+    }
+    if (!smoke)
+        return objects;
+
+    smoke->march_step = march_step;
+    std::cerr << "grid medium: " << smoke->resolution[0] << " x " << smoke->resolution[1] << " x " << smoke->resolution[2]
+              << " voxels, empty majorant cells = " << 100 * smoke->empty_fraction() << "%, "
+              << (march_step > 0 ? "ray marching" : "delta tracking") << "\n";
+    objects.add(smoke);
+
+    return objects;
+}
+
+/// Cornell box 中的大量小光源：一半是天花板上朝下的小矩形，一半是散落在房间里的小球，
+/// 辐亮度按对数均匀分布跨越两个数量级，总功率和原来的顶灯相同
+hittable_list cornell_many_lights(int light_count) {
+    hittable_list objects;
+
+    auto red = arena_make_shared<lambertian>(Color(.65, .05, .05));
+    auto white = arena_make_shared<lambertian>(Color(.73, .73, .73));
+    auto green = arena_make_shared<lambertian>(Color(.12, .45, .15));
+
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 555, green));
+    objects.add(arena_make_shared<yz_rect>(0, 555, 0, 555, 0, red));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 0, white));
+    objects.add(arena_make_shared<xz_rect>(0, 555, 0, 555, 555, white));
+    objects.add(arena_make_shared<xy_rect>(0, 555, 0, 555, 555, white));
+
+    shared_ptr<hittable> box1 = arena_make_shared<box>(Point3(0, 0, 0), Point3(165, 330, 165), white);
+    box1 = arena_make_shared<rotate_y>(box1, 15);
+    box1 = arena_make_shared<translate>(box1, Vec3(265, 0, 295));
+    objects.add(box1);
+    objects.add(arena_make_shared<Sphere>(Point3(190, 90, 190), 90, white));
+
+    // 灯越多越小：矩形边长和球半径随 1 / sqrt(n) 缩小
+    const auto size = clamp(400 / sqrt(real(light_count)), 2, 60);
+    const auto radius = size / 4;
+    struct emitter_spec {
+        Point3 position;    // 矩形的一角或球心
+        real strength;
+        Color tint;
+    };
+    std::vector<emitter_spec> specs;
+    real total_power = 0;
+    for (int i = 0; i < light_count; i++) {
+        emitter_spec spec;
+        spec.strength = pow(real(10), random_double(0, 2));
+        spec.tint = Color::random(0.5, 1);
+        if (i % 2 == 0) {
+            spec.position = Point3(random_double(0, 555 - size), 554, random_double(0, 555 - size));
+            total_power += spec.strength * size * size;
+        } else {
+            spec.position = Point3(random_double(50, 505), random_double(20, 300), random_double(50, 505));
+            total_power += spec.strength * 4 * pi * radius * radius;
+        }
+        specs.push_back(spec);
+    }
+
+    // 归一化到原来顶灯的功率 130 x 105 x 15
+    const auto scale = 130 * 105 * 15 / total_power;
+    for (int i = 0; i < light_count; i++) {
+        const auto &spec = specs[i];
+        auto radiance = scale * spec.strength;
+        auto light = arena_make_shared<diffuse_light>(radiance * spec.tint);
+        if (i % 2 == 0) {
+            const auto &p = spec.position;
+            objects.add(arena_make_shared<flip_face>(arena_make_shared<xz_rect>(p.x(), p.x() + size, p.z(), p.z() + size, p.y(), light)));
+        } else {
+            objects.add(arena_make_shared<Sphere>(spec.position, radius, light));
+        }
+    }
+
+    return objects;
+}
+
+// 用法：TheRestOfYourLife [场景编号] [每像素样本数] [图像宽度] [是否使用场景 arena (1/0)] [模型文件 (场景 11 / 12 为 OBJ，13 为点云，14 / 15 为体素或 perlin)] [场景 15 的步长]
+//       [样本生成器 sobol (默认) / random / bluenoise (低 spp 预览)] [俄罗斯轮盘开始的弹射次数，默认 3，>= 50 关闭]
+//       [场景 16 的灯数，默认 1000] [选灯的方式 alias (按功率，不超过 64 个灯时的默认) / bvh (光源树，更多灯时的默认) / uniform]
+int main(int argc, char *argv[]) {
 
     clock_t start, end;
     start = clock();
 
+    const int scene_id = argc > 1 ? atoi(argv[1]) : 0;
+    const int spp_override = argc > 2 ? atoi(argv[2]) : 0;
+    const int width_override = argc > 3 ? atoi(argv[3]) : 0;
+    const bool use_arena = argc > 4 ? atoi(argv[4]) != 0 : true;
+    const char *model_file = argc > 5 ? argv[5] : (scene_id == 13 ? "points.ply" : scene_id >= 14 ? "perlin" : "model.obj");
+    const real march_step = argc > 6 ? atof(argv[6]) : 2;
+    const std::string sampler_name = argc > 7 ? argv[7] : "sobol";
+    roulette_depth = argc > 8 ? atoi(argv[8]) : 3;
+    const int light_count = argc > 9 ? std::max(1, atoi(argv[9])) : 1000;
+    const std::string light_sampler = argc > 10 ? argv[10] : "";
+
     // Image
 
     auto aspect_ratio = 2.5;
     int image_width = 860;
     int image_height = static_cast<int>(image_width / aspect_ratio);
     int samples_per_pixel = 500; // 样本数，从每个像素发出的射线数 500
-    const int max_depth = 50; // 50
 
     // World & Camera
 
-    hittable_list world;
+    // 图元、材质和纹理从场景 arena 中连续分配，随场景一起一次性释放；必须在 world 之前构造
+    arena scene_arena;
+    arena_scope scene_scope(use_arena ? &scene_arena : nullptr);
 
-    shared_ptr<hittable> lights = make_shared<xz_rect>(213, 343, 227, 332, 554, shared_ptr<material>());
-//    shared_ptr<hittable> lights = make_shared<Sphere>(Point3(190, 90, 190), 90, shared_ptr<material>());
+    const auto allocations_before_build = heap_allocations();
+    const clock_t build_start = clock();
 
-//    auto lights = make_shared<hittable_list>();
-//    lights->add(make_shared<xz_rect>(213, 343, 227, 332, 554, shared_ptr<material>()));
-//    lights->add(make_shared<Sphere>(Point3(190, 90, 190), 90, shared_ptr<material>()));
-
-//    lights->add(make_shared<Sphere>(Point3(190, 165+80, 190), 80, shared_ptr<material>()));
-//    lights->add(make_shared<xz_rect>(35, 40, 0, 555, 554, shared_ptr<material>()));
-//    lights->add(make_shared<xz_rect>(110, 115, 0, 555, 1, shared_ptr<material>()));
+    hittable_list world;
 
 
     Point3 lookfrom;
@@ -615,7 +1010,7 @@ int main() {
     Vec3 vup(0, 1, 0);
     Color background(0, 0, 0);
 
-    switch (0) {
+    switch (scene_id) {
         case 1:
             world = random_scene();
             background = Color(0.70, 0.80, 1.00);
@@ -697,18 +1092,166 @@ int main() {
             aperture = 0.1;
 
             break;
+
+        case 9:
+            world = final_scene();
+            aspect_ratio = 1.0;
+            image_width = 800;
+            image_height = 800;
+            samples_per_pixel = 10000;
+            background = Color(0, 0, 0);
+            lookfrom = Point3(478, 278, -600);
+            lookat = Point3(278, 278, 0);
+            vfov = 40.0;
+            break;
+
+        case 10:
+            world = cornell_box_cover3();
+            aspect_ratio = 1.0;
+            image_width = 512;
+            image_height = 512;
+            samples_per_pixel = 200;
+            background = Color(0, 0, 0);
+            lookfrom = Point3(278, 278, -800);
+            lookat = Point3(278, 278, 0);
+            vfov = 40.0;
+            break;
+
+        case 11:
+        case 12:    // 同一个网格，压缩存储
+            world = cornell_box_mesh(model_file, scene_id == 12);
+            aspect_ratio = 1.0;
+            image_width = 600;
+            image_height = 600;
+            samples_per_pixel = 100;
+            background = Color(0, 0, 0);
+            lookfrom = Point3(278, 278, -800);
+            lookat = Point3(278, 278, 0);
+            vfov = 40.0;
+            break;
+
+        case 13:
+            world = cornell_box_points(model_file);
+            aspect_ratio = 1.0;
+            image_width = 600;
+            image_height = 600;
+            samples_per_pixel = 100;
+            background = Color(0, 0, 0);
+            lookfrom = Point3(278, 278, -800);
+            lookat = Point3(278, 278, 0);
+            vfov = 40.0;
+            break;
+        case 14:
+        case 15:    // 同一团烟，固定步长 ray marching
+            world = cornell_grid_smoke(model_file, scene_id == 15 ? march_step : 0);
+            aspect_ratio = 1.0;
+            image_width = 600;
+            image_height = 600;
+            samples_per_pixel = 100;
+            background = Color(0, 0, 0);
+            lookfrom = Point3(278, 278, -800);
+            lookat = Point3(278, 278, 0);
+            vfov = 40.0;
+            break;
+
+        case 16:
+            world = cornell_many_lights(light_count);
+            aspect_ratio = 1.0;
+            image_width = 512;
+            image_height = 512;
+            samples_per_pixel = 200;
+            background = Color(0, 0, 0);
+            lookfrom = Point3(278, 278, -800);
+            lookat = Point3(278, 278, 0);
+            vfov = 40.0;
+            break;
+
+        case 17:
+            world = cornell_box_new();
+            aspect_ratio = 1.0;
+            image_width = 512;
+            image_height = 512;
+            samples_per_pixel = 200;
+            background = Color(0, 0, 0);
+            lookfrom = Point3(278, 278, -800);
+            lookat = Point3(278, 278, 0);
+            vfov = 40.0;
+            break;
+    }
+
+    // 光源：场景中所有 diffuse_light 材质的矩形和球，按功率选择。灯少时用别名表，成千上万个灯时用光源树
+    const auto emitters = find_emitters(world, 0.0, 1.0);
+    const std::string selection = !light_sampler.empty() ? light_sampler : emitters.size() > 64 ? "bvh" : "alias";
+    const clock_t light_build_start = clock();
+    shared_ptr<hittable> lights;
+    if (selection == "uniform") {
+        auto list = arena_make_shared<hittable_list>();
+        for (const auto &e: emitters)
+            list->add(e.object);
+        lights = list;
+    } else if (selection == "bvh") {
+        auto tree = arena_make_shared<light_bvh>();
+        for (const auto &e: emitters)
+            tree->add(e.object, e.radiance, true);
+        tree->build(0.0, 1.0);
+        lights = tree;
+    } else {
+        auto list = arena_make_shared<light_list>();
+        for (const auto &e: emitters)
+            list->add(e.object, e.radiance);
+        list->build(0.0, 1.0);
+        lights = list;
+    }
+    std::cerr << "lights = " << emitters.size() << " found in the scene, selection = "
+              << (selection == "uniform" ? "uniform" : selection == "bvh" ? "light BVH" : "power (alias table)")
+              << ", build = " << double(clock() - light_build_start) / CLOCKS_PER_SEC << "s\n";
+
+    if (spp_override > 0)
+        samples_per_pixel = spp_override;
+    if (width_override > 0) {
+        image_width = width_override;
+        image_height = static_cast<int>(image_width / aspect_ratio);
     }
 
     camera cam(lookfrom, lookat, vup, vfov, aspect_ratio, aperture, dist_to_focus, 0.0, 1.0);
 
+    // 把场景编译成按类型分组的图元数组 + 线性 BVH
+    scene world_scene(world, 0.0, 1.0);
+    std::cerr << "primitives = " << world_scene.primitive_count()
+              << " (custom = " << world_scene.custom.size()
+              << ", instances = " << world_scene.instances.size()
+              << ", wrapper levels removed = " << world_scene.wrappers_removed << ")"
+              << (world_scene.atmosphere >= 0 ? ", global fog kept outside the BVH" : "") << "\n";
+
+    std::cerr << "scene build = " << double(clock() - build_start) / CLOCKS_PER_SEC << "s"
+              << ", heap allocations = " << heap_allocations() - allocations_before_build
+              << ", arena = " << (use_arena ? scene_arena.bytes_used() / 1024.0 : 0.0) << " KB"
+              << " in " << scene_arena.block_count() << " blocks (malloc, not counted above)"
+              << ", peak memory = " << peak_memory_bytes() / (1024.0 * 1024.0) << " MB\n";
+
     // Render
 
+    // 渲染中所有的随机数都来自样本生成器：每个像素样本按 sample_dimension 的布局使用各个维度
+    sobol_sampler sobol;
+    independent_sampler independent;
+    blue_noise_sampler blue_noise(image_width, samples_per_pixel);
+    sampler &pixel_sampler = sampler_name == "random" ? static_cast<sampler &>(independent)
+                             : sampler_name == "bluenoise" ? static_cast<sampler &>(blue_noise) : sobol;
+    sampler_scope sampling_scope(&pixel_sampler);
+    std::cerr << "sampler = " << (&pixel_sampler == &sobol ? "Owen-scrambled Sobol"
+                                  : &pixel_sampler == &blue_noise ? "blue-noise Sobol (Z-order tiles)"
+                                  : "independent random") << "\n";
+
     // 没有用 CMake 和 string，直接用的 MSBuild，改为文件 IO，添加 C/C++ 预处理器定义 _CRT_SECURE_NO_WARNINGS
     FILE *f = fopen(file_name, "w");
     fprintf(f, "P3\n%d %d\n%d\n", image_width, image_height, 255);
 
+    // 渲染循环开始前的堆分配次数，稳定状态下渲染循环不应该再分配
+    const auto allocations_before_render = heap_allocations();
+    const clock_t render_start = clock();
+
     // 从左上角开始，从左到右逐行写入每个像素的颜色值
-    for (int j = image_height; j >= 0; --j) {
+    for (int j = image_height - 1; j >= 0; --j) {
         std::cerr << "\rScanlines remaining: " << j << ' ' << std::flush;
 
         for (int i = 0; i < image_width; ++i) {
@@ -716,11 +1259,14 @@ int main() {
 
             // 按样本数在每个像素中进行随机偏移采样
             for (int s = 0; s < samples_per_pixel; ++s) {
+                pixel_sampler.start_pixel_sample(static_cast<uint32_t>(j * image_width + i), static_cast<uint32_t>(s));
                 auto u = (i + random_double()) / (double(image_width) - 1);
                 auto v = (j + random_double()) / (double(image_height) - 1);
 
+
+                skip_to_dimension(dim_lens);
                 Ray ray = cam.get_ray(u, v);
-                pixel_color += ray_color(ray, background, world, lights, max_depth);
+                pixel_color += ray_color(ray, background, world_scene, *lights);
             }
 
             double r = pixel_color.x();
@@ -747,7 +1293,21 @@ int main() {
     }
 
     std::cerr << "\nDone.\n";
+    std::cerr << "heap allocations during render = " << heap_allocations() - allocations_before_render << "\n";
 
     end = clock();   //结束时间
     std::cerr << "\ntime = " << double(end - start) / CLOCKS_PER_SEC << "s\n";
+
+    // 吞吐量与内存，用于比较单精度和双精度构建
+    auto render_seconds = double(end - render_start) / CLOCKS_PER_SEC;
+    std::cerr << "precision = " << (sizeof(real) == sizeof(float) ? "float" : "double")
+              << ", samples/s = " << double(image_width) * image_height * samples_per_pixel / render_seconds << "\n";
+    std::cerr << "average path length = " << double(path_segments) / (double(image_width) * image_height * samples_per_pixel)
+              << " segments (roulette from bounce " << roulette_depth << ", max " << max_depth << ")"
+              << ", rays/s = " << (path_segments + shadow_rays) / render_seconds
+              << " (" << path_segments << " path + " << shadow_rays << " shadow)\n";
+    std::cerr << "sizeof(Vec3) = " << sizeof(Vec3) << ", sizeof(Ray) = " << sizeof(Ray)
+              << ", sizeof(aabb) = " << sizeof(aabb) << ", sizeof(bvh_node) = " << sizeof(bvh_node)
+              << ", sizeof(Sphere) = " << sizeof(Sphere) << "\n";
+    std::cerr << "peak memory = " << peak_memory_bytes() / (1024.0 * 1024.0) << " MB\n";
 }
@@ -13,12 +13,25 @@ struct scatter_record {
     Ray specular_ray;
     bool is_specular;
     Color attenuation;
-    shared_ptr<pdf> pdf_ptr;
+    pdf sample_pdf;     // 按值存放的采样分布，镜面材质为空
+};
+
+// 内置材质的类型标签，用于下面 material_*() 的封闭集合分发；自定义材质为 custom，走虚函数。
+// 分发按标签直接调用内置类的函数，子类的覆盖会被跳过，所以内置材质都是 final，自定义材质从 material 派生
+enum class material_type : unsigned char {
+    custom,
+    lambertian,
+    metal,
+    dielectric,
+    diffuse_light,
+    isotropic
 };
 
 class material {
 public:
-    virtual Color emitted(const Ray &r_in, const hit_record &rec, double u, double v, const Point3 &p) const {
+    material(material_type t = material_type::custom) : type(t) {}
+
+    virtual Color emitted(const Ray &r_in, const hit_record &rec, real u, real v, const Point3 &p) const {
         return Color(0, 0, 0);
     }
 
@@ -26,15 +39,18 @@ public:
         return false;
     };
 
-    virtual double scattering_pdf(const Ray &r_in, const hit_record &rec, const Ray &scattered) const {
+    virtual real scattering_pdf(const Ray &r_in, const hit_record &rec, const Ray &scattered) const {
         return 0;
     }
+
+public:
+    material_type type;
 };
 
-class lambertian : public material {
+class lambertian final : public material {
 public:
-    lambertian(const Color &a) : albedo(make_shared<solid_color>(a)) {}
-    lambertian(shared_ptr<texture> a) : albedo(a) {}
+    lambertian(const Color &a) : material(material_type::lambertian), albedo(arena_make_shared<solid_color>(a)) {}
+    lambertian(shared_ptr<texture> a) : material(material_type::lambertian), albedo(a) {}
 
     virtual bool scatter(const Ray &r_in, const hit_record &rec, scatter_record &srec) const override {
 
@@ -62,13 +78,13 @@ public:
         // pdf = 0.5 / pi;  // 1 / 2PI
 
         srec.is_specular = false;
-        srec.attenuation = albedo->value(rec.u, rec.v, rec.p);
-        srec.pdf_ptr = make_shared<cosine_pdf>(rec.normal);
+        srec.attenuation = texture_value(*albedo, rec.u, rec.v, rec.p);
+        srec.sample_pdf = cosine_pdf(rec.normal);
         return true;
     }
 
     // 散射 pdf
-    double scattering_pdf(const Ray &r_in, const hit_record &rec, const Ray &scattered) const {
+    real scattering_pdf(const Ray &r_in, const hit_record &rec, const Ray &scattered) const {
         auto cosine = dot(rec.normal, unit_vector(scattered.direction()));
         return cosine < 0 ? 0 : cosine / pi;
         // return cosine < 0 ? 0 : 0.5 / pi;
@@ -78,9 +94,9 @@ public:
     shared_ptr<texture> albedo;
 };
 
-class metal : public material {
+class metal final : public material {
 public:
-    metal(const Color &a, double f) : albedo(a), fuzz(f < 1 ? f : 1) {}
+    metal(const Color &a, real f) : material(material_type::metal), albedo(a), fuzz(f < 1 ? f : 1) {}
 
     virtual bool scatter(const Ray &r_in, const hit_record &rec, scatter_record &srec) const override {
         Vec3 reflected = reflect(unit_vector(r_in.direction()), rec.normal);
@@ -88,32 +104,32 @@ public:
         // scattered = Ray(rec.p, reflected + fuzz * random_in_unit_sphere(), r_in.time());
         // attenuation = albedo;
         // return (dot(scattered.direction(), rec.normal) > 0);
-        srec.specular_ray = Ray(rec.p, reflected + fuzz * random_in_unit_sphere());
+        srec.specular_ray = rec.spawn_ray(reflected + fuzz * random_in_unit_sphere(), r_in.time());
         srec.attenuation = albedo;
         srec.is_specular = true;
-        srec.pdf_ptr = nullptr;
+        srec.sample_pdf = pdf();
         return true;
     }
 
 public:
     Color albedo;
-    double fuzz;
+    real fuzz;
 };
 
-class dielectric : public material {
+class dielectric final : public material {
 public:
-    dielectric(double index_of_refraction) : ir(index_of_refraction) {}
+    dielectric(real index_of_refraction) : material(material_type::dielectric), ir(index_of_refraction) {}
 
     virtual bool scatter(const Ray &r_in, const hit_record &rec, scatter_record &srec) const override {
         srec.is_specular = true;
-        srec.pdf_ptr = nullptr;
+        srec.sample_pdf = pdf();
         srec.attenuation = Color(1.0, 1.0, 1.0);
-        double refraciton_ratio = rec.front_face ? (1.0 / ir) : ir;
+        real refraciton_ratio = rec.front_face ? (1.0 / ir) : ir;
 
         Vec3 unit_direction = unit_vector(r_in.direction());
 
-        double cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
-        double sin_theta = sqrt(1.0 - cos_theta * cos_theta);
+        real cos_theta = fmin(dot(-unit_direction, rec.normal), 1.0);
+        real sin_theta = sqrt(1.0 - cos_theta * cos_theta);
 
         bool cannot_refract = refraciton_ratio * sin_theta > 1.0;
         Vec3 direction;
@@ -123,53 +139,53 @@ public:
             direction = refract(unit_direction, rec.normal, refraciton_ratio);
         }
 
-        srec.specular_ray = Ray(rec.p, direction, r_in.time());
+        srec.specular_ray = rec.spawn_ray(direction, r_in.time());
         return true;
     }
 
 public:
-    double ir; // Index of Refreaction
+    real ir; // Index of Refreaction
 
 private:
-    static double reflectance(double cosine, double ref_idx) {
+    static real reflectance(real cosine, real ref_idx) {
         auto r0 = (1 - ref_idx) / (1 + ref_idx);
         r0 = r0 * r0;
         return r0 + (1 - r0) * pow((1 - cosine), 5);
     }
 };
 
-class diffuse_light : public material {
+class diffuse_light final : public material {
 public:
-    diffuse_light(shared_ptr<texture> a) : emit(a) {}
+    diffuse_light(shared_ptr<texture> a) : material(material_type::diffuse_light), emit(a) {}
 
-    diffuse_light(Color c) : emit(make_shared<solid_color>(c)) {}
+    diffuse_light(Color c) : material(material_type::diffuse_light), emit(arena_make_shared<solid_color>(c)) {}
 
-    Color emitted(const Ray &r_in, const hit_record &rec, double u, double v, const Point3 &p) const override {
+    Color emitted(const Ray &r_in, const hit_record &rec, real u, real v, const Point3 &p) const override {
         if (!rec.front_face) {
             return Color(0, 0, 0);
         }
-        return emit->value(u, v, p);
+        return texture_value(*emit, u, v, p);
     }
 
 public:
     shared_ptr<texture> emit;
 };
 
-class isotropic : public material {
+class isotropic final : public material {
 public:
-    isotropic(Color c) : albedo(make_shared<solid_color>(c)) {}
+    isotropic(Color c) : material(material_type::isotropic), albedo(arena_make_shared<solid_color>(c)) {}
 
-    isotropic(shared_ptr<texture> a) : albedo(a) {}
+    isotropic(shared_ptr<texture> a) : material(material_type::isotropic), albedo(a) {}
 
     virtual bool scatter(const Ray &r_in, const hit_record &rec, scatter_record& srec) const override {
 //        scattered = Ray(rec.p, random_in_unit_sphere(), r_in.time());
-        srec.attenuation = albedo->value(rec.u, rec.v, rec.p);
-        srec.pdf_ptr = make_shared<sphere_pdf>();
+        srec.attenuation = texture_value(*albedo, rec.u, rec.v, rec.p);
+        srec.sample_pdf = sphere_pdf();
         srec.is_specular = false;
         return true;
     }
 
-    double scattering_pdf(const Ray& r_in, const hit_record& rec, const Ray& scattered) const override {
+    real scattering_pdf(const Ray& r_in, const hit_record& rec, const Ray& scattered) const override {
         return 1 / (4 * pi);
     }
 
@@ -177,4 +193,48 @@ public:
     shared_ptr<texture> albedo;
 };
 
+// 材质的封闭集合分发：内置材质按标签 switch 后直接调用 (可内联)，自定义材质退回虚函数
+
+inline Color material_emitted(const material &m, const Ray &r_in, const hit_record &rec, real u, real v,
+                              const Point3 &p) {
+    switch (m.type) {
+        case material_type::diffuse_light:
+            return static_cast<const diffuse_light &>(m).diffuse_light::emitted(r_in, rec, u, v, p);
+        case material_type::custom:
+            return m.emitted(r_in, rec, u, v, p);
+        default:
+            return Color(0, 0, 0);
+    }
+}
+
+inline bool material_scatter(const material &m, const Ray &r_in, const hit_record &rec, scatter_record &srec) {
+    switch (m.type) {
+        case material_type::lambertian:
+            return static_cast<const lambertian &>(m).lambertian::scatter(r_in, rec, srec);
+        case material_type::metal:
+            return static_cast<const metal &>(m).metal::scatter(r_in, rec, srec);
+        case material_type::dielectric:
+            return static_cast<const dielectric &>(m).dielectric::scatter(r_in, rec, srec);
+        case material_type::isotropic:
+            return static_cast<const isotropic &>(m).isotropic::scatter(r_in, rec, srec);
+        case material_type::diffuse_light:
+            return false;
+        default:
+            return m.scatter(r_in, rec, srec);
+    }
+}
+
+inline real material_scattering_pdf(const material &m, const Ray &r_in, const hit_record &rec, const Ray &scattered) {
+    switch (m.type) {
+        case material_type::lambertian:
+            return static_cast<const lambertian &>(m).lambertian::scattering_pdf(r_in, rec, scattered);
+        case material_type::isotropic:
+            return static_cast<const isotropic &>(m).isotropic::scattering_pdf(r_in, rec, scattered);
+        case material_type::custom:
+            return m.scattering_pdf(r_in, rec, scattered);
+        default:
+            return 0;
+    }
+}
+
 #endif
\ No newline at end of file
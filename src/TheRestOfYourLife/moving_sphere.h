@@ -7,61 +7,61 @@
 
 #include "../common//rtweekend.h"
 #include "hittable.h"
+#include "sphere.h"
 
 class moving_sphere : public hittable {
 public:
     moving_sphere() = default;
 
-    moving_sphere(Point3 cen0, Point3 cen1, double _time0, double _time1, double r, shared_ptr<material> m) :
+    moving_sphere(Point3 cen0, Point3 cen1, real _time0, real _time1, real r, shared_ptr<material> m) :
             center0(cen0), center1(cen1), time0(_time0), time1(_time1), radius(r), mat_ptr(m) {};
 
-    virtual bool hit(const Ray &r, double t_min, double t_max, hit_record &rec) const override;
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override;
 
-    virtual bool bounding_box(double time0, double _time1, aabb &output_box) const override;
+    virtual bool intersect(const Ray &r, real t_min, real t_max, real &t) const override;
 
-    Point3 center(double time) const;
+    virtual bool interval(const Ray &r, real t_min, real t_max, real &t_enter, real &t_exit) const override {
+        return sphere_interval(center(r.time()), radius, r, t_min, t_max, t_enter, t_exit);
+    }
+
+    void surface_interaction(const Ray &r, real t, hit_record &rec) const;
+
+    virtual bool bounding_box(real time0, real _time1, aabb &output_box) const override;
+
+    Point3 center(real time) const;
 
 public:
     Point3 center0, center1;
-    double time0, time1;
-    double radius;
+    real time0, time1;
+    real radius;
     shared_ptr<material> mat_ptr;
 };
 
-Point3 moving_sphere::center(double time) const {
+Point3 moving_sphere::center(real time) const {
     return center0 + ((time - time0) / (time1 - time0)) * (center1 - center0);
 }
 
-bool moving_sphere::hit(const Ray &r, double t_min, double t_max, hit_record &rec) const {
-    Vec3 oc = r.origin() - center(r.time());              // 射线起点到球体中心
-
-    // 简化的求根公式
-    auto a = r.direction().length_squared();
-    auto half_b = dot(oc, r.direction());
-    auto c = oc.length_squared() - radius * radius;
-    auto discriminant = half_b * half_b - a * c;
-
-    if (discriminant < 0) return false;
-    auto sqrtd = sqrt(discriminant);
-
-    // 找到距离最近的根，并判断是否在可接受的范围内：[0.001, infinity]
-    auto root = (-half_b - sqrtd) / a;
-    if (root < t_min || t_max < root) {
-        root = (-half_b + sqrtd) / a;
-        if (root < t_min || t_max < root)
-            return false;
-    }
+bool moving_sphere::intersect(const Ray &r, real t_min, real t_max, real &t) const {
+    return intersect_sphere(center(r.time()), radius, r, t_min, t_max, t);
+}
 
-    rec.t = root;
+void moving_sphere::surface_interaction(const Ray &r, real t, hit_record &rec) const {
+    rec.t = t;
     rec.p = r.at(rec.t);
     Vec3 outward_normal = (rec.p - center(r.time())) / radius;
     rec.set_face_normal(r, outward_normal);
-    rec.mat_ptr = mat_ptr;
+    rec.mat_ptr = mat_ptr.get();
+}
 
+bool moving_sphere::hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
+    real t;
+    if (!intersect(r, t_min, t_max, t))
+        return false;
+    surface_interaction(r, t, rec);
     return true;
 }
 
-bool moving_sphere::bounding_box(double _time0, double _time1, aabb &output_box) const {
+bool moving_sphere::bounding_box(real _time0, real _time1, aabb &output_box) const {
     aabb box0(
             center(_time0) - Vec3(radius, radius, radius),
             center(_time0) + Vec3(radius, radius, radius));
@@ -0,0 +1,237 @@
+//
+// Streaming Wavefront OBJ loader producing a triangle_mesh.
+//
+
+#ifndef RAY_TRACING_OBJ_LOADER_H
+#define RAY_TRACING_OBJ_LOADER_H
+
+#include "rtweekend.h"
+
+#include "triangle_mesh.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace obj_detail {
+    inline bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    inline void skip_spaces(const char *&p) {
+        while (is_space(*p)) p++;
+    }
+
+    // 十进制浮点数解析。OBJ 的数值都是普通的定点或科学计数法，不需要 strtod 的本地化和十六进制处理；
+    // 尾数超过 19 位有效数字时截断，误差远小于 float 的精度
+    inline float parse_float(const char *&p) {
+        static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                         1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        skip_spaces(p);
+        bool negative = *p == '-';
+        if (*p == '-' || *p == '+') p++;
+
+        uint64_t mantissa = 0;
+        int digits = 0;
+        int exponent = 0;
+        for (; *p >= '0' && *p <= '9'; p++) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) digits++;
+            } else {
+                exponent++;
+            }
+        }
+        if (*p == '.') {
+            for (p++; *p >= '0' && *p <= '9'; p++) {
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    if (mantissa) digits++;
+                    exponent--;
+                }
+            }
+        }
+        if (*p == 'e' || *p == 'E') {
+            p++;
+            bool negative_exponent = *p == '-';
+            if (*p == '-' || *p == '+') p++;
+            int e = 0;
+            for (; *p >= '0' && *p <= '9'; p++)
+                e = std::min(e * 10 + (*p - '0'), 10000);
+            exponent += negative_exponent ? -e : e;
+        }
+
+        double value = static_cast<double>(mantissa);
+        while (exponent > 22) { value *= 1e22; exponent -= 22; }
+        while (exponent < -22) { value /= 1e22; exponent += 22; }
+        value = exponent >= 0 ? value * powers[exponent] : value / powers[-exponent];
+        return static_cast<float>(negative ? -value : value);
+    }
+
+    // 面的下标：从 1 开始，负数表示从当前末尾倒数。0 或缺失返回 -1
+    inline int64_t parse_index(const char *&p, size_t count) {
+        bool negative = *p == '-';
+        if (*p == '-' || *p == '+') p++;
+        if (*p < '0' || *p > '9')
+            return -1;
+        int64_t value = 0;
+        for (; *p >= '0' && *p <= '9'; p++)
+            value = value * 10 + (*p - '0');
+        if (value == 0)
+            return -1;
+        return negative ? static_cast<int64_t>(count) - value : value - 1;
+    }
+}
+
+// 从 OBJ 文件读取三角网格，读取统计 (顶点、三角形数量) 可以从返回的网格查询。
+// 文件按固定大小的块读入并逐行解析，不一次性读入整个文件，也不为每行构造字符串。
+// 只解析 v / vt / vn / f，多边形按扇形三角化，其余指令 (o, g, s, mtllib, usemtl ...) 忽略，整个网格使用材质 m。
+// quantize 为 true 时网格使用压缩存储 (见 triangle_mesh)。文件不存在或下标越界时返回空指针
+shared_ptr<triangle_mesh> load_obj(const char *filename, shared_ptr<material> m, bool quantize = false) {
+    FILE *file = fopen(filename, "rb");
+    if (!file) {
+        std::cerr << "ERROR Could not open OBJ file '" << filename << "'.\n";
+        return nullptr;
+    }
+
+    auto mesh = arena_make_shared<triangle_mesh>(m);
+    bool all_normals = true;    // 所有面的每个顶点都有 vn / vt 时才保留对应的下标
+    bool all_uvs = true;
+    bool bad_index = false;
+
+    // 一个面的顶点下标，多边形的顶点数不固定
+    std::vector<int64_t> face_v, face_vt, face_vn;
+
+    auto parse_line = [&](const char *p) {
+        using namespace obj_detail;
+        skip_spaces(p);
+
+        if (p[0] == 'v' && is_space(p[1])) {
+            p++;
+            for (int k = 0; k < 3; k++)
+                mesh->positions.push_back(parse_float(p));
+        } else if (p[0] == 'v' && p[1] == 'n' && is_space(p[2])) {
+            p += 2;
+            for (int k = 0; k < 3; k++)
+                mesh->normals.push_back(parse_float(p));
+        } else if (p[0] == 'v' && p[1] == 't' && is_space(p[2])) {
+            p += 2;
+            for (int k = 0; k < 2; k++)
+                mesh->uvs.push_back(parse_float(p));
+        } else if (p[0] == 'f' && is_space(p[1])) {
+            p++;
+            face_v.clear();
+            face_vt.clear();
+            face_vn.clear();
+
+            // 顶点格式：v、v/vt、v//vn、v/vt/vn
+            while (true) {
+                skip_spaces(p);
+                if (*p == '\n' || *p == '#' || *p == '\0')
+                    break;
+                auto v = parse_index(p, mesh->positions.size() / 3);
+                int64_t vt = -1, vn = -1;
+                if (*p == '/') {
+                    p++;
+                    if (*p != '/')
+                        vt = parse_index(p, mesh->uvs.size() / 2);
+                    if (*p == '/') {
+                        p++;
+                        vn = parse_index(p, mesh->normals.size() / 3);
+                    }
+                }
+                if (v < 0) {
+                    bad_index = true;
+                    return;
+                }
+                face_v.push_back(v);
+                face_vt.push_back(vt);
+                face_vn.push_back(vn);
+                while (*p != '\n' && *p != '\0' && !is_space(*p))
+                    p++;
+            }
+
+            for (size_t k = 2; k < face_v.size(); k++) {
+                const size_t corner[3] = {0, k - 1, k};
+                for (auto c: corner) {
+                    mesh->position_index.push_back(static_cast<uint32_t>(face_v[c]));
+                    all_uvs = all_uvs && face_vt[c] >= 0;
+                    all_normals = all_normals && face_vn[c] >= 0;
+                    if (all_uvs)
+                        mesh->uv_index.push_back(static_cast<uint32_t>(face_vt[c]));
+                    if (all_normals)
+                        mesh->normal_index.push_back(static_cast<uint32_t>(face_vn[c]));
+                }
+            }
+        }
+    };
+
+    // 按块读入，块末尾不完整的一行移到下一块的开头。超过块大小的行让缓冲区翻倍
+    std::vector<char> buffer(1 << 20);
+    size_t carry = 0;
+    bool eof = false;
+    while (!eof) {
+        // 留出一个字节，给没有换行符的最后一行补上 '\n'。每一行都以 '\n' 结尾，解析不会越过行尾
+        auto request = buffer.size() - 1 - carry;
+        auto got = fread(buffer.data() + carry, 1, request, file);
+        eof = got < request;
+        auto size = carry + got;
+
+        size_t end = size;
+        if (!eof) {
+            while (end > 0 && buffer[end - 1] != '\n') end--;
+            if (end == 0) {
+                // 一行比整个缓冲区还长
+                carry = size;
+                buffer.resize(buffer.size() * 2);
+                continue;
+            }
+        } else if (size > 0 && buffer[size - 1] != '\n') {
+            buffer[size++] = '\n';
+            end = size;
+        }
+
+        const char *line = buffer.data();
+        const char *stop = buffer.data() + end;
+        while (line < stop) {
+            parse_line(line);
+            line = static_cast<const char *>(std::memchr(line, '\n', stop - line)) + 1;
+        }
+
+        carry = size - end;
+        std::memmove(buffer.data(), buffer.data() + end, carry);
+    }
+    fclose(file);
+
+    if (!all_normals)
+        std::vector<uint32_t>().swap(mesh->normal_index);
+    if (!all_uvs)
+        std::vector<uint32_t>().swap(mesh->uv_index);
+
+    // 下标越界检查
+    auto check = [&](const std::vector<uint32_t> &index, size_t count) {
+        for (auto i: index) {
+            if (i >= count)
+                return false;
+        }
+        return true;
+    };
+    if (bad_index || !check(mesh->position_index, mesh->positions.size() / 3)
+        || !check(mesh->normal_index, mesh->normals.size() / 3) || !check(mesh->uv_index, mesh->uvs.size() / 2)) {
+        std::cerr << "ERROR Invalid face index in OBJ file '" << filename << "'.\n";
+        return nullptr;
+    }
+
+    // 读取时按倍数增长的数组收缩到实际大小
+    mesh->positions.shrink_to_fit();
+    mesh->normals.shrink_to_fit();
+    mesh->uvs.shrink_to_fit();
+    mesh->position_index.shrink_to_fit();
+    mesh->normal_index.shrink_to_fit();
+    mesh->uv_index.shrink_to_fit();
+
+    mesh->build(quantize);
+    return mesh;
+}
+
+#endif //RAY_TRACING_OBJ_LOADER_H
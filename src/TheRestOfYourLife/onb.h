@@ -17,7 +17,7 @@ public:
     Vec3 v() const { return axis[1]; }
     Vec3 w() const { return axis[2]; }
 
-    Vec3 local(double a, double b, double c) const {
+    Vec3 local(real a, real b, real c) const {
         return a * u() + b * v() + c * w();
     }
 
@@ -10,27 +10,22 @@
 #include "hittable.h"
 #include "hittable_list.h"
 
-class pdf {
-public:
-    virtual ~pdf() {}
-
-    virtual double value(const Vec3 &direction) const = 0;
-
-    virtual Vec3 generate() const = 0;
-};
+// 采样分布都是按值使用的小对象，直接放在栈上，每次弹射不再有堆分配和引用计数
 
-class cosine_pdf : public pdf {
+class cosine_pdf {
 public:
+    cosine_pdf() {}
+
     cosine_pdf(const Vec3 &w) {
         uvw.build_from_w(w);
     }
 
-    double value(const Vec3 &direction) const override {
+    real value(const Vec3 &direction) const {
         auto cosine = dot(unit_vector(direction), uvw.w());
         return (cosine <= 0) ? 0 : cosine / pi;
     }
 
-    Vec3 generate() const override {
+    Vec3 generate() const {
         return uvw.local(random_cosine_direction());
     }
 
@@ -38,62 +33,148 @@ public:
     onb uvw;
 };
 
-class hittable_pdf : public pdf {
+class hittable_pdf {
 public:
-    hittable_pdf(shared_ptr<hittable> p, const Point3 &origin) : ptr(p), o(origin) {}
-//    hittable_pdf(hittable _object, const Point3 &_origin) : objects(_object), origin(_origin) {}
+    hittable_pdf() {}
+
+    hittable_pdf(const hittable &p, const Point3 &origin) : o(origin), ptr(&p) {}
 
-    double value(const Vec3 &direction) const override {
+    real value(const Vec3 &direction) const {
         return ptr->pdf_value(o, direction);
     }
 
-    Vec3 generate() const override {
+    Vec3 generate() const {
         return ptr->random(o);
     }
 
 public:
     Point3 o;
-    shared_ptr<hittable> ptr;
+    const hittable *ptr;    // 不持有所有权，灯光对象的生命周期覆盖整个渲染过程
+};
+
+class sphere_pdf {
+public:
+    sphere_pdf() {}
 
-//    const hittable &objects;
-//    Point3 origin;
+    real value(const Vec3 &direction) const {
+        return 1 / (4 * pi);
+    }
+
+    Vec3 generate() const {
+        return random_unit_vector();
+    }
 };
 
-class mixture_pdf : public pdf {
+// 以下两个是射线上距离的分布：沿单位方向的距离 s 限制在区间 [s0, s1] 内，用于在介质中选取散射点
+
+// 等角采样：按从点 c (灯上的一点) 看过去的角度均匀取点，pdf 与 1 / |x(s) - c|² 成正比，
+// 靠近灯的一段取得更密，抵消直接光的平方衰减
+class equiangular_pdf {
 public:
-    mixture_pdf(shared_ptr<pdf> p0, shared_ptr<pdf> p1) {
-        p[0] = p0;
-        p[1] = p1;
+    equiangular_pdf() {}
+
+    // origin 和 unit_direction 是射线，c 是灯上的点
+    equiangular_pdf(const Point3 &origin, const Vec3 &unit_direction, const Point3 &c, real s0, real s1) {
+        delta = dot(c - origin, unit_direction);
+        D = (origin + delta * unit_direction - c).length();
+        theta0 = atan2(s0 - delta, D);
+        theta1 = atan2(s1 - delta, D);
     }
 
-    double value(const Vec3 &direction) const override {
-        // p0 直接光，p1 全局光
-        return 0.5 * p[0]->value(direction) + 0.5 * p[1]->value(direction);
+    // c 在射线所在的直线上时分布退化
+    bool valid() const { return D > 0 && theta1 > theta0; }
+
+    real value(real s) const {
+        auto x = s - delta;
+        return D / ((theta1 - theta0) * (D * D + x * x));
     }
 
-    Vec3 generate() const override {
-        if (random_double() < 0.5) {
-            return p[0]->generate();
-        } else {
-            return p[1]->generate();
-        }
+    real generate() const {
+        return delta + D * tan(theta0 + random_double() * (theta1 - theta0));
     }
 
 public:
-    shared_ptr<pdf> p[2];
+    // 默认构造的分布无效 (valid() 为 false)
+    real delta = 0;     // c 在射线上的投影到起点的距离
+    real D = 0;         // c 到射线的距离
+    real theta0 = 0, theta1 = 0;
 };
 
-class sphere_pdf : public pdf {
+// 截断的指数分布：按均匀介质的透射率 exp(-sigma * (s - s0)) 取点
+class exponential_pdf {
 public:
-    sphere_pdf() { }
+    exponential_pdf() {}
+
+    exponential_pdf(real sigma, real s0, real s1) : sigma(sigma), s0(s0), mass(1 - exp(-sigma * (s1 - s0))) {}
 
-    double value(const Vec3& direction) const override {
-        return 1/ (4 * pi);
+    real value(real s) const {
+        return sigma * exp(-sigma * (s - s0)) / mass;
     }
 
-    Vec3 generate() const override {
-        return random_unit_vector();
+    real generate() const {
+        return s0 - log(1 - random_double() * mass) / sigma;
     }
+
+public:
+    real sigma;
+    real s0;
+    real mass;      // [s0, s1] 内的概率，用于归一化
+};
+
+// cosine / sphere / hittable 三种分布的标签联合
+class pdf {
+public:
+    enum pdf_type : unsigned char {
+        none,
+        cosine,
+        sphere,
+        hittable
+    };
+
+    pdf() : type(none), sph() {}
+
+    pdf(const cosine_pdf &p) : type(cosine), cos(p) {}
+
+    pdf(const sphere_pdf &p) : type(sphere), sph(p) {}
+
+    pdf(const hittable_pdf &p) : type(hittable), hit(p) {}
+
+    bool empty() const { return type == none; }
+
+    real value(const Vec3 &direction) const {
+        switch (type) {
+            case cosine:
+                return cos.value(direction);
+            case sphere:
+                return sph.value(direction);
+            case hittable:
+                return hit.value(direction);
+            default:
+                return 0;
+        }
+    }
+
+    Vec3 generate() const {
+        switch (type) {
+            case cosine:
+                return cos.generate();
+            case sphere:
+                return sph.generate();
+            case hittable:
+                return hit.generate();
+            default:
+                return Vec3(1, 0, 0);
+        }
+    }
+
+public:
+    pdf_type type;
+
+    union {
+        cosine_pdf cos;
+        sphere_pdf sph;
+        hittable_pdf hit;
+    };
 };
 
 #endif //RAY_TRACING_PDF_H
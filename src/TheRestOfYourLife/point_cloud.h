@@ -0,0 +1,305 @@
+//
+// Memory-mapped point cloud loader (binary PLY or raw float32 xyz) producing a sphere_set.
+//
+
+#ifndef RAY_TRACING_POINT_CLOUD_H
+#define RAY_TRACING_POINT_CLOUD_H
+
+#include "rtweekend.h"
+
+#include "sphere_set.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 只读映射整个文件，析构时解除映射。打开失败时 data 为空
+class mapped_file {
+public:
+    explicit mapped_file(const char *filename);
+
+    ~mapped_file();
+
+    mapped_file(const mapped_file &) = delete;
+
+    mapped_file &operator=(const mapped_file &) = delete;
+
+public:
+    const char *data = nullptr;
+    size_t size = 0;
+
+private:
+#if defined(_WIN32)
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+};
+
+#if defined(_WIN32)
+mapped_file::mapped_file(const char *filename) {
+    file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+        return;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+        return;
+    data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    size = data ? static_cast<size_t>(file_size.QuadPart) : 0;
+}
+
+mapped_file::~mapped_file() {
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+}
+#else
+mapped_file::mapped_file(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void *p = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p != MAP_FAILED) {
+            // 只顺序读一遍，内核可以提前读入并及早回收读过的页
+            madvise(p, static_cast<size_t>(info.st_size), MADV_SEQUENTIAL);
+            data = static_cast<const char *>(p);
+            size = static_cast<size_t>(info.st_size);
+        }
+    }
+    close(fd);  // 映射建立后不再需要文件描述符
+}
+
+mapped_file::~mapped_file() {
+    if (data) munmap(const_cast<char *>(data), size);
+}
+#endif
+
+namespace ply_detail {
+    // PLY 标量类型的字节数，未知类型返回 0
+    inline int type_size(const std::string &type) {
+        if (type == "char" || type == "uchar" || type == "int8" || type == "uint8") return 1;
+        if (type == "short" || type == "ushort" || type == "int16" || type == "uint16") return 2;
+        if (type == "int" || type == "uint" || type == "int32" || type == "uint32"
+            || type == "float" || type == "float32") return 4;
+        if (type == "double" || type == "float64") return 8;
+        return 0;
+    }
+
+    inline bool host_little_endian() {
+        const uint16_t probe = 1;
+        char first;
+        std::memcpy(&first, &probe, 1);
+        return first == 1;
+    }
+
+    // 点的一个坐标分量：在顶点记录中的偏移和类型 (只支持 float / double)
+    struct field {
+        int offset = -1;
+        int size = 0;
+    };
+
+    inline real read_field(const char *record, const field &f, bool swap) {
+        char bytes[8];
+        std::memcpy(bytes, record + f.offset, f.size);
+        if (swap) {
+            for (int i = 0; i < f.size / 2; i++)
+                std::swap(bytes[i], bytes[f.size - 1 - i]);
+        }
+        if (f.size == 4) {
+            float value;
+            std::memcpy(&value, bytes, 4);
+            return value;
+        }
+        double value;
+        std::memcpy(&value, bytes, 8);
+        return static_cast<real>(value);
+    }
+}
+
+// 读取点云，每个点成为一个半径为 radius 的小球，所有球使用材质 m。
+// 文件整个映射到内存，点直接从映射的数据写入 sphere_set 的 SoA 数组，不为每个点分配对象。
+// 支持两种格式：
+//   - 二进制 PLY (little / big endian)：读取 vertex 元素的 x / y / z，有 radius 属性时用它作为半径；
+//     vertex 之前的元素只能有定长属性，其余属性 (颜色、法线 ...) 忽略
+//   - 其他文件按无文件头的 float32 x, y, z 序列读取 (本机字节序)，文件大小必须是 12 的倍数
+// radius <= 0 时按点的密度自动选择：包围盒对角线 / sqrt(点数) 的一半，即表面点云平均间距的量级。
+// 返回的集合还没有 build，调用者 build 后使用，方便分别统计读取和建树的时间。格式错误时返回空指针
+shared_ptr<sphere_set> load_point_cloud(const char *filename, real radius, shared_ptr<material> m) {
+    using namespace ply_detail;
+
+    mapped_file file(filename);
+    if (!file.data) {
+        std::cerr << "ERROR Could not open point cloud file '" << filename << "'.\n";
+        return nullptr;
+    }
+
+    const char *points = file.data;     // 第一个点的记录
+    size_t count = 0;
+    size_t stride = 3 * sizeof(float);
+    field x, y, z, r;
+    x.offset = 0, y.offset = 4, z.offset = 8;
+    x.size = y.size = z.size = 4;
+    bool swap = false;
+
+    const bool is_ply = file.size >= 4 && std::memcmp(file.data, "ply", 3) == 0
+                        && (file.data[3] == '\n' || file.data[3] == '\r');
+    if (is_ply) {
+        // 文件头是文本，以 end_header 一行结束，只在文件开头 1 MiB 内查找
+        const char *header_end = nullptr;
+        const char *search_end = file.data + std::min(file.size, static_cast<size_t>(1) << 20);
+        for (const char *p = file.data; p + 10 <= search_end; p++) {
+            if (std::memcmp(p, "end_header", 10) == 0) {
+                header_end = static_cast<const char *>(std::memchr(p, '\n', file.data + file.size - p));
+                break;
+            }
+        }
+        if (!header_end) {
+            std::cerr << "ERROR Missing end_header in PLY file '" << filename << "'.\n";
+            return nullptr;
+        }
+
+        bool binary = false;
+        bool vertex_seen = false;
+        bool in_vertex = false;
+        bool list_before_vertex = false;
+        size_t skipped = 0;        // vertex 之前的元素占用的字节数
+        size_t element_count = 0, element_stride = 0;
+        stride = 0;
+        x.offset = y.offset = z.offset = -1;
+
+        // 结束上一个元素：vertex 之前的元素跳过
+        auto finish_element = [&]() {
+            if (!vertex_seen)
+                skipped += element_count * element_stride;
+        };
+
+        const char *line = file.data;
+        while (line < header_end) {
+            const char *end = static_cast<const char *>(std::memchr(line, '\n', header_end + 1 - line));
+            std::string text(line, end - line);
+            line = end + 1;
+            if (!text.empty() && text.back() == '\r')
+                text.pop_back();
+
+            char word[64] = {}, type[64] = {}, name[64] = {};
+            unsigned long long number = 0;
+            if (std::sscanf(text.c_str(), "%63s", word) != 1)
+                continue;
+            const std::string keyword = word;
+
+            if (keyword == "format") {
+                if (std::sscanf(text.c_str(), "%*s %63s", type) == 1) {
+                    const std::string format = type;
+                    binary = format == "binary_little_endian" || format == "binary_big_endian";
+                    swap = (format == "binary_big_endian") == host_little_endian();
+                }
+            } else if (keyword == "element") {
+                if (std::sscanf(text.c_str(), "%*s %63s %llu", name, &number) != 2)
+                    continue;
+                if (in_vertex)
+                    vertex_seen = true;
+                finish_element();
+                in_vertex = !vertex_seen && std::string(name) == "vertex";
+                element_count = static_cast<size_t>(number);
+                element_stride = 0;
+                if (in_vertex)
+                    count = element_count;
+            } else if (keyword == "property") {
+                if (std::sscanf(text.c_str(), "%*s %63s %63s", type, name) != 2)
+                    continue;
+                if (std::string(type) == "list") {
+                    if (in_vertex || !vertex_seen)
+                        list_before_vertex = true;
+                    continue;
+                }
+                const int size = type_size(type);
+                // 不认识的类型不知道占几个字节，顶点的步长和要跳过的字节数都会算错
+                if (size == 0 && (in_vertex || !vertex_seen)) {
+                    std::cerr << "ERROR Unsupported PLY file '" << filename << "' (unknown property type '"
+                              << type << "').\n";
+                    return nullptr;
+                }
+                if (in_vertex) {
+                    const std::string property = name;
+                    field *target = nullptr;
+                    if (property == "x") target = &x;
+                    else if (property == "y") target = &y;
+                    else if (property == "z") target = &z;
+                    else if (property == "radius") target = &r;
+                    if (target && (size == 4 || size == 8) && std::string(type).find("int") == std::string::npos) {
+                        target->offset = static_cast<int>(stride);
+                        target->size = size;
+                    }
+                    stride += size;
+                } else {
+                    element_stride += size;
+                }
+            }
+        }
+        if (in_vertex)
+            vertex_seen = true;
+
+        if (!binary || list_before_vertex || !vertex_seen || x.offset < 0 || y.offset < 0 || z.offset < 0) {
+            std::cerr << "ERROR Unsupported PLY file '" << filename
+                      << "' (need binary vertices with float / double x, y, z and no list properties before them).\n";
+            return nullptr;
+        }
+        points = header_end + 1 + skipped;
+        if (static_cast<size_t>(points - file.data) + count * stride > file.size) {
+            std::cerr << "ERROR Truncated PLY file '" << filename << "'.\n";
+            return nullptr;
+        }
+    } else {
+        if (file.size % stride != 0) {
+            std::cerr << "ERROR Raw point cloud file '" << filename << "' is not a sequence of float32 x, y, z.\n";
+            return nullptr;
+        }
+        count = file.size / stride;
+    }
+
+    // BVH 用 32 位编号
+    if (count == 0 || count >= 0xffffffffu) {
+        std::cerr << "ERROR Point cloud '" << filename << "' has " << count << " points.\n";
+        return nullptr;
+    }
+
+    auto point = [&](size_t i) {
+        const char *record = points + i * stride;
+        return Point3(read_field(record, x, swap), read_field(record, y, swap), read_field(record, z, swap));
+    };
+
+    const bool radius_from_file = r.offset >= 0;
+    if (!radius_from_file && radius <= 0) {
+        aabb box = aabb::empty();
+        for (size_t i = 0; i < count; i++) {
+            auto p = point(i);
+            box = surrounding_box(box, aabb(p, p));
+        }
+        radius = 0.5 * (box.max() - box.min()).length() / std::sqrt(static_cast<real>(count));
+    }
+
+    auto set = arena_make_shared<sphere_set>();
+    set->reserve(count);
+    for (size_t i = 0; i < count; i++)
+        set->add(point(i), radius_from_file ? read_field(points + i * stride, r, swap) : radius, m);
+    return set;
+}
+
+#endif //RAY_TRACING_POINT_CLOUD_H
@@ -0,0 +1,486 @@
+//
+// Compiled scene: primitives grouped into type-homogeneous arrays under one flat BVH.
+//
+
+#ifndef RAY_TRACING_SCENE_H
+#define RAY_TRACING_SCENE_H
+
+#include "rtweekend.h"
+
+#include "hittable.h"
+#include "hittable_list.h"
+#include "bvh.h"
+#include "sphere.h"
+#include "sphere_set.h"
+#include "triangle_mesh.h"
+#include "moving_sphere.h"
+#include "aarect.h"
+#include "box.h"
+#include "constant_medium.h"
+#include "instance.h"
+
+#include <cstdint>
+#include <vector>
+
+// 场景中的图元类型，custom 表示没有专门数组的类型 (包装器、自定义 hittable)，走虚函数
+enum class primitive_type : uint8_t {
+    sphere,
+    sphere_set,
+    mesh,
+    moving_sphere,
+    xy_rect,
+    xz_rect,
+    yz_rect,
+    box,
+    transformed_box,
+    medium,
+    instance,
+    custom,
+    custom_medium       // 没有专门数组的介质，和 custom 一样走虚函数
+};
+
+struct primitive_ref {
+    primitive_type type;
+    bool flipped;       // 烘焙进来的 flip_face：命中后翻转 front_face
+    uint32_t index;     // 在对应类型数组中的下标
+};
+
+// 把 hittable_list 编译成按类型分组的数组和一棵线性 BVH：
+// 内层循环按类型标签 switch，对具体类型做非虚调用，求交函数可以被内联；
+// 无法识别的类型保留为 shared_ptr<hittable>，作为较慢的虚函数后备。
+class scene : public hittable {
+public:
+    scene() = default;
+
+    scene(const hittable_list &list, real time0, real time1) {
+        build(list, time0, time1);
+    }
+
+    void build(const hittable_list &list, real time0, real time1);
+
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override {
+        real segment_end;
+        return nearest_hit<false>(r, t_min, t_max, rec, segment_end);
+    }
+
+    // 同上，另外返回全局雾之外最近的事件 (表面或其他介质) 的 t，没有时为 t_max。
+    // 射线在全局雾中经过的就是 [t_min, segment_end] 这一段
+    bool hit(const Ray &r, real t_min, real t_max, hit_record &rec, real &segment_end) const {
+        return nearest_hit<false>(r, t_min, t_max, rec, segment_end);
+    }
+
+    // 最近的表面交点，跳过所有介质。阴影射线用它找到光源 (或遮挡物)，介质的衰减由 transmittance 单独计算
+    bool hit_surface(const Ray &r, real t_min, real t_max, hit_record &rec) const {
+        real segment_end;
+        return nearest_hit<true>(r, t_min, t_max, rec, segment_end);
+    }
+
+    const constant_medium *atmosphere_medium() const {
+        return atmosphere >= 0 ? &media[atmosphere] : nullptr;
+    }
+
+    // 射线 [t_min, t_max] 段上所有介质透射率的乘积，不考虑表面遮挡
+    virtual real transmittance(const Ray &r, real t_min, real t_max) const override;
+
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override {
+        output_box = bvh.bounding_box();
+        return !bvh.nodes.empty();
+    }
+
+    size_t primitive_count() const { return refs.size(); }
+
+public:
+    std::vector<Sphere> spheres;
+    std::vector<shared_ptr<sphere_set>> sphere_sets;   // 点云和网格可能很大，只保存指针不复制
+    std::vector<shared_ptr<triangle_mesh>> meshes;
+    std::vector<moving_sphere> moving_spheres;
+    std::vector<xy_rect> xy_rects;
+    std::vector<xz_rect> xz_rects;
+    std::vector<yz_rect> yz_rects;
+    std::vector<box> boxes;
+    std::vector<transformed_primitive<box>> transformed_boxes;
+    std::vector<constant_medium> media;
+    std::vector<instance> instances;
+    std::vector<shared_ptr<hittable>> custom;
+
+    std::vector<primitive_ref> refs;
+    flat_bvh bvh;
+
+    size_t wrappers_removed = 0;    // 构建时烘焙进图元、不再参与求交的包装器层数
+    size_t medium_count = 0;        // BVH 中的介质数量，没有时 transmittance 不用遍历
+
+    // 全局雾：边界是球、并且包住其余所有图元 (比它还大的图元，例如用作地面的大球，除外) 的均匀介质，不放进 BVH。
+    // 它的包围盒覆盖整个场景，放在树里每条射线都要访问它；单独处理时只在最近表面之前按解析的球内区间采样一次自由程。
+    // -1 表示没有
+    int atmosphere = -1;
+
+private:
+    // 展开包装器时累积的状态：还没有烘焙进图元的变换和面朝向翻转
+    struct bake_state {
+        transform object_to_world;
+        bool transformed = false;
+        bool flipped = false;
+    };
+
+    void add(const shared_ptr<hittable> &object, const bake_state &state);
+
+    // 子树中的图元能否直接烘焙变换 xf：平移可以改写任何基本图元的坐标，
+    // 旋转、缩放只有 box 能烘焙 (transformed_box)。被共享的子物体保留为 instance
+    static bool bakeable(const hittable &object, const transform &xf);
+
+    template<typename T>
+    void add_typed(std::vector<T> &array, primitive_type type, const T &object, bool flipped) {
+        refs.push_back({type, flipped, static_cast<uint32_t>(array.size())});
+        array.push_back(object);
+    }
+
+    static bool is_medium(primitive_type type) {
+        return type == primitive_type::medium || type == primitive_type::custom_medium;
+    }
+
+    template<bool SkipMedia>
+    bool nearest_hit(const Ray &r, real t_min, real t_max, hit_record &rec, real &segment_end) const;
+
+    bool hit_primitive(const primitive_ref &ref, const Ray &r, real t_min, real t_max, hit_record &rec) const;
+
+    // 遍历阶段的求交：基本图元只求 t，不写 rec；集合、介质和 custom 图元直接写完整的 rec
+    bool intersect_primitive(const primitive_ref &ref, const Ray &r, real t_min, real t_max, real &t, hit_record &rec) const;
+
+    // 基本图元的表面信息在遍历结束后计算
+    static bool is_deferred(primitive_type type) {
+        return type == primitive_type::sphere || type == primitive_type::moving_sphere || type == primitive_type::xy_rect
+               || type == primitive_type::xz_rect || type == primitive_type::yz_rect || type == primitive_type::box
+               || type == primitive_type::transformed_box;
+    }
+
+    void surface_interaction(const primitive_ref &ref, const Ray &r, real t, hit_record &rec) const;
+
+    bool primitive_box(const primitive_ref &ref, real time0, real time1, aabb &output_box) const;
+};
+
+void scene::build(const hittable_list &list, real time0, real time1) {
+    for (const auto &object: list.objects)
+        add(object, bake_state());
+
+    std::vector<aabb> bounds(refs.size());
+    for (size_t i = 0; i < refs.size(); i++) {
+        if (!primitive_box(refs[i], time0, time1, bounds[i]))
+            std::cerr << "No bounding box in scene constructor.\n";
+    }
+
+    // 包围盒的 8 个顶点都在球内
+    auto encloses = [](const Sphere &sphere, const aabb &box) {
+        real distance_squared = 0;
+        for (int a = 0; a < 3; a++) {
+            auto d = fmax(fabs(box.min()[a] - sphere.center[a]), fabs(box.max()[a] - sphere.center[a]));
+            distance_squared += d * d;
+        }
+        return distance_squared <= sphere.radius * sphere.radius;
+    };
+    for (size_t i = 0; i < refs.size() && atmosphere < 0; i++) {
+        if (refs[i].type != primitive_type::medium)
+            continue;
+        auto sphere = dynamic_cast<const Sphere *>(media[refs[i].index].boundary.get());
+        if (!sphere)
+            continue;
+        const auto fog_area = bounds[i].surface_area();
+        bool all_inside = true;
+        for (size_t j = 0; j < refs.size() && all_inside; j++)
+            all_inside = j == i || encloses(*sphere, bounds[j]) || bounds[j].surface_area() > fog_area;
+        if (all_inside) {
+            atmosphere = static_cast<int>(refs[i].index);
+            refs.erase(refs.begin() + i);
+            bounds.erase(bounds.begin() + i);
+            medium_count--;
+        }
+    }
+
+    bvh.build(bounds);
+
+    // 按叶子顺序重排引用，叶子范围直接对应 refs 中的连续区间
+    std::vector<primitive_ref> ordered(refs.size());
+    for (size_t i = 0; i < refs.size(); i++)
+        ordered[i] = refs[bvh.indices[i]];
+    refs.swap(ordered);
+}
+
+bool scene::bakeable(const hittable &object, const transform &xf) {
+    const hittable *p = &object;
+
+    if (auto list = dynamic_cast<const hittable_list *>(p)) {
+        for (const auto &child: list->objects) {
+            if (!bakeable(*child, xf))
+                return false;
+        }
+        return true;
+    }
+    if (auto node = dynamic_cast<const bvh_node *>(p))
+        return bakeable(*node->left, xf) && bakeable(*node->right, xf);
+    if (auto flip = dynamic_cast<const flip_face *>(p))
+        return bakeable(*flip->ptr, xf);
+    if (auto inst = dynamic_cast<const instance *>(p))
+        return inst->ptr.use_count() == 1 && bakeable(*inst->ptr, xf * inst->object_to_world);
+    if (dynamic_cast<const box *>(p))
+        return true;
+    if (dynamic_cast<const Sphere *>(p) || dynamic_cast<const moving_sphere *>(p) || dynamic_cast<const xy_rect *>(p)
+        || dynamic_cast<const xz_rect *>(p) || dynamic_cast<const yz_rect *>(p))
+        return xf.is_translation();
+    return false;
+}
+
+// 展开列表、BVH 和只用一次的包装器链，已知类型复制进对应数组，其余类型保留指针。
+// flip_face 变成引用上的标记，变换直接改写图元坐标，或者和 box 存放在一起 (transformed_box)
+void scene::add(const shared_ptr<hittable> &object, const bake_state &state) {
+    if (!object)
+        return;
+
+    const hittable *p = object.get();
+    const bool flipped = state.flipped;
+    const auto &xf = state.object_to_world;
+    const Vec3 offset = xf.point(Point3(0, 0, 0));
+
+    if (auto list = dynamic_cast<const hittable_list *>(p)) {
+        for (const auto &child: list->objects)
+            add(child, state);
+    } else if (auto node = dynamic_cast<const bvh_node *>(p)) {
+        // 只有一个物体的节点左右子节点相同
+        add(node->left, state);
+        if (node->right != node->left)
+            add(node->right, state);
+    } else if (auto flip = dynamic_cast<const flip_face *>(p)) {
+        auto inner = state;
+        inner.flipped = !flipped;
+        wrappers_removed++;
+        add(flip->ptr, inner);
+    } else if (auto inst = dynamic_cast<const instance *>(p)) {
+        const auto composed = xf * inst->object_to_world;
+        if (inst->ptr.use_count() == 1 && bakeable(*inst->ptr, composed)) {
+            auto inner = state;
+            inner.object_to_world = composed;
+            inner.transformed = true;
+            wrappers_removed += inst->levels;
+            add(inst->ptr, inner);
+        } else {
+            // bakeable 对整棵子树判断，外层已经烘焙的变换不会落到这里
+            add_typed(instances, primitive_type::instance, *inst, flipped);
+        }
+    } else if (auto b = dynamic_cast<const box *>(p)) {
+        if (!state.transformed) {
+            add_typed(boxes, primitive_type::box, *b, flipped);
+        } else if (xf.is_translation()) {
+            auto moved = *b;
+            moved.box_min += offset;
+            moved.box_max += offset;
+            add_typed(boxes, primitive_type::box, moved, flipped);
+        } else {
+            add_typed(transformed_boxes, primitive_type::transformed_box, transformed_primitive<box>(*b, xf), flipped);
+        }
+    } else if (auto sphere = dynamic_cast<const Sphere *>(p)) {
+        auto moved = *sphere;
+        moved.center += offset;
+        add_typed(spheres, primitive_type::sphere, moved, flipped);
+    } else if (auto set = std::dynamic_pointer_cast<sphere_set>(object)) {
+        add_typed(sphere_sets, primitive_type::sphere_set, set, flipped);
+    } else if (auto mesh = std::dynamic_pointer_cast<triangle_mesh>(object)) {
+        add_typed(meshes, primitive_type::mesh, mesh, flipped);
+    } else if (auto msphere = dynamic_cast<const moving_sphere *>(p)) {
+        auto moved = *msphere;
+        moved.center0 += offset;
+        moved.center1 += offset;
+        add_typed(moving_spheres, primitive_type::moving_sphere, moved, flipped);
+    } else if (auto rect = dynamic_cast<const xy_rect *>(p)) {
+        auto moved = *rect;
+        moved.x0 += offset.x();
+        moved.x1 += offset.x();
+        moved.y0 += offset.y();
+        moved.y1 += offset.y();
+        moved.k += offset.z();
+        add_typed(xy_rects, primitive_type::xy_rect, moved, flipped);
+    } else if (auto rect = dynamic_cast<const xz_rect *>(p)) {
+        auto moved = *rect;
+        moved.x0 += offset.x();
+        moved.x1 += offset.x();
+        moved.z0 += offset.z();
+        moved.z1 += offset.z();
+        moved.k += offset.y();
+        add_typed(xz_rects, primitive_type::xz_rect, moved, flipped);
+    } else if (auto rect = dynamic_cast<const yz_rect *>(p)) {
+        auto moved = *rect;
+        moved.y0 += offset.y();
+        moved.y1 += offset.y();
+        moved.z0 += offset.z();
+        moved.z1 += offset.z();
+        moved.k += offset.x();
+        add_typed(yz_rects, primitive_type::yz_rect, moved, flipped);
+    } else if (auto medium = dynamic_cast<const constant_medium *>(p)) {
+        add_typed(media, primitive_type::medium, *medium, flipped);
+        medium_count++;
+    } else {
+        const bool is_custom_medium = object->is_medium();
+        refs.push_back({is_custom_medium ? primitive_type::custom_medium : primitive_type::custom, flipped,
+                        static_cast<uint32_t>(custom.size())});
+        custom.push_back(object);
+        medium_count += is_custom_medium;
+    }
+}
+
+bool scene::hit_primitive(const primitive_ref &ref, const Ray &r, real t_min, real t_max, hit_record &rec) const {
+    switch (ref.type) {
+        case primitive_type::sphere:
+            return spheres[ref.index].Sphere::hit(r, t_min, t_max, rec);
+        case primitive_type::sphere_set:
+            return sphere_sets[ref.index]->sphere_set::hit(r, t_min, t_max, rec);
+        case primitive_type::mesh:
+            return meshes[ref.index]->triangle_mesh::hit(r, t_min, t_max, rec);
+        case primitive_type::moving_sphere:
+            return moving_spheres[ref.index].moving_sphere::hit(r, t_min, t_max, rec);
+        case primitive_type::xy_rect:
+            return xy_rects[ref.index].xy_rect::hit(r, t_min, t_max, rec);
+        case primitive_type::xz_rect:
+            return xz_rects[ref.index].xz_rect::hit(r, t_min, t_max, rec);
+        case primitive_type::yz_rect:
+            return yz_rects[ref.index].yz_rect::hit(r, t_min, t_max, rec);
+        case primitive_type::box:
+            return boxes[ref.index].box::hit(r, t_min, t_max, rec);
+        case primitive_type::transformed_box:
+            return transformed_boxes[ref.index].hit(r, t_min, t_max, rec);
+        case primitive_type::medium:
+            return media[ref.index].constant_medium::hit(r, t_min, t_max, rec);
+        case primitive_type::instance:
+            return instances[ref.index].instance::hit(r, t_min, t_max, rec);
+        default:
+            return custom[ref.index]->hit(r, t_min, t_max, rec);
+    }
+}
+
+bool scene::primitive_box(const primitive_ref &ref, real time0, real time1, aabb &output_box) const {
+    switch (ref.type) {
+        case primitive_type::sphere:
+            return spheres[ref.index].bounding_box(time0, time1, output_box);
+        case primitive_type::sphere_set:
+            return sphere_sets[ref.index]->bounding_box(time0, time1, output_box);
+        case primitive_type::mesh:
+            return meshes[ref.index]->bounding_box(time0, time1, output_box);
+        case primitive_type::moving_sphere:
+            return moving_spheres[ref.index].bounding_box(time0, time1, output_box);
+        case primitive_type::xy_rect:
+            return xy_rects[ref.index].bounding_box(time0, time1, output_box);
+        case primitive_type::xz_rect:
+            return xz_rects[ref.index].bounding_box(time0, time1, output_box);
+        case primitive_type::yz_rect:
+            return yz_rects[ref.index].bounding_box(time0, time1, output_box);
+        case primitive_type::box:
+            return boxes[ref.index].bounding_box(time0, time1, output_box);
+        case primitive_type::transformed_box:
+            return transformed_boxes[ref.index].bounding_box(time0, time1, output_box);
+        case primitive_type::medium:
+            return media[ref.index].bounding_box(time0, time1, output_box);
+        case primitive_type::instance:
+            return instances[ref.index].bounding_box(time0, time1, output_box);
+        default:
+            return custom[ref.index]->bounding_box(time0, time1, output_box);
+    }
+}
+
+bool scene::intersect_primitive(const primitive_ref &ref, const Ray &r, real t_min, real t_max, real &t, hit_record &rec) const {
+    switch (ref.type) {
+        case primitive_type::sphere:
+            return spheres[ref.index].Sphere::intersect(r, t_min, t_max, t);
+        case primitive_type::moving_sphere:
+            return moving_spheres[ref.index].moving_sphere::intersect(r, t_min, t_max, t);
+        case primitive_type::xy_rect:
+            return xy_rects[ref.index].xy_rect::intersect(r, t_min, t_max, t);
+        case primitive_type::xz_rect:
+            return xz_rects[ref.index].xz_rect::intersect(r, t_min, t_max, t);
+        case primitive_type::yz_rect:
+            return yz_rects[ref.index].yz_rect::intersect(r, t_min, t_max, t);
+        case primitive_type::box:
+            return boxes[ref.index].box::intersect(r, t_min, t_max, t);
+        case primitive_type::transformed_box:
+            return transformed_boxes[ref.index].intersect(r, t_min, t_max, t);
+        default:
+            if (!hit_primitive(ref, r, t_min, t_max, rec))
+                return false;
+            t = rec.t;
+            return true;
+    }
+}
+
+void scene::surface_interaction(const primitive_ref &ref, const Ray &r, real t, hit_record &rec) const {
+    switch (ref.type) {
+        case primitive_type::sphere:
+            return spheres[ref.index].Sphere::surface_interaction(r, t, rec);
+        case primitive_type::moving_sphere:
+            return moving_spheres[ref.index].moving_sphere::surface_interaction(r, t, rec);
+        case primitive_type::xy_rect:
+            return xy_rects[ref.index].xy_rect::surface_interaction(r, t, rec);
+        case primitive_type::xz_rect:
+            return xz_rects[ref.index].xz_rect::surface_interaction(r, t, rec);
+        case primitive_type::yz_rect:
+            return yz_rects[ref.index].yz_rect::surface_interaction(r, t, rec);
+        case primitive_type::box:
+            return boxes[ref.index].box::surface_interaction(r, t, rec);
+        case primitive_type::transformed_box:
+            return transformed_boxes[ref.index].surface_interaction(r, t, rec);
+        default:
+            return;
+    }
+}
+
+// 遍历时只记录最近的 t 和图元，交点、法线和 uv 只为最终的最近图元计算一次
+template<bool SkipMedia>
+bool scene::nearest_hit(const Ray &r, real t_min, real t_max, hit_record &rec, real &segment_end) const {
+    const primitive_ref *nearest = nullptr;
+    real nearest_t = t_max;
+
+    bool hit_anything = bvh.traverse(r, t_min, t_max, [&](uint32_t first, uint32_t count, real &closest) {
+        bool hit_leaf = false;
+        for (auto i = first; i < first + count; i++) {
+            if (SkipMedia && is_medium(refs[i].type))
+                continue;
+            real t;
+            if (intersect_primitive(refs[i], r, t_min, closest, t, rec)) {
+                hit_leaf = true;
+                closest = nearest_t = t;
+                nearest = &refs[i];
+            }
+        }
+        return hit_leaf;
+    });
+
+    // 全局雾在最近的表面之前散射时，rec 由介质写好
+    segment_end = nearest_t;
+    if (!SkipMedia && atmosphere >= 0 && media[atmosphere].constant_medium::hit(r, t_min, nearest_t, rec))
+        return true;
+
+    if (!hit_anything)
+        return false;
+
+    // 非延迟的图元在遍历中已经写好了 rec
+    if (is_deferred(nearest->type))
+        surface_interaction(*nearest, r, nearest_t, rec);
+    if (nearest->flipped)
+        rec.front_face = !rec.front_face;
+
+    return hit_anything;
+}
+
+real scene::transmittance(const Ray &r, real t_min, real t_max) const {
+    real tr = atmosphere >= 0 ? media[atmosphere].constant_medium::transmittance(r, t_min, t_max) : 1;
+    if (medium_count == 0)
+        return tr;
+
+    // 访问所有包围盒与 [t_min, t_max] 相交的叶子，不缩短区间
+    bvh.traverse(r, t_min, t_max, [&](uint32_t first, uint32_t count, real &) {
+        for (auto i = first; i < first + count; i++) {
+            if (refs[i].type == primitive_type::medium)
+                tr *= media[refs[i].index].constant_medium::transmittance(r, t_min, t_max);
+            else if (refs[i].type == primitive_type::custom_medium)
+                tr *= custom[refs[i].index]->transmittance(r, t_min, t_max);
+        }
+        return false;
+    });
+    return tr;
+}
+
+#endif //RAY_TRACING_SCENE_H
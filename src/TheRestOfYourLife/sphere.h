@@ -8,23 +8,32 @@ class Sphere : public hittable {
 public:
     Sphere() {}
 
-    Sphere(Point3 cen, double r, shared_ptr<material> m) : center(cen), radius(r), mat_ptr(m) {};
+    Sphere(Point3 cen, real r, shared_ptr<material> m) : center(cen), radius(r), mat_ptr(m) {};
 
-    virtual bool hit(const Ray &r, double t_min, double t_max, hit_record &rec) const override;
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override;
 
-    virtual bool bounding_box(double time0, double time1, aabb &output_box) const override;
+    // 延迟的表面信息：遍历时只用 intersect 求 t，最终的最近交点再调用 surface_interaction
+    virtual bool intersect(const Ray &r, real t_min, real t_max, real &t) const override;
 
-    virtual double pdf_value(const Point3 &o, const Vec3 &v) const override;
+    virtual bool interval(const Ray &r, real t_min, real t_max, real &t_enter, real &t_exit) const override;
+
+    void surface_interaction(const Ray &r, real t, hit_record &rec) const;
+
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override;
+
+    virtual real pdf_value(const Point3 &o, const Vec3 &v) const override;
 
     virtual Vec3 random(const Point3 &o) const override;
 
+    virtual bool emitter_bounds(real time0, real time1, light_bounds &out) const override;
+
 public:
     Point3 center;
-    double radius;
+    real radius;
     shared_ptr<material> mat_ptr;
 
-private:
-    static void get_sphere_uv(const Point3 &p, double &u, double &v) {
+public:
+    static void get_sphere_uv(const Point3 &p, real &u, real &v) {
         // p: 单位球面上的一个点，以原点为中心
         // u: 返回从 X=-1 绕 Y 轴的角度值 [0,1]
         // v: 返回从 Y=-1 到 Y=+1 的角度值 [0,1]
@@ -40,8 +49,8 @@ private:
     }
 };
 
-// Sphere 求交
-bool Sphere::hit(const Ray &r, double t_min, double t_max, hit_record &rec) const {
+// 射线与球面的两个交点 root0 <= root1 (射线参数 t)，不相交时返回 false
+inline bool sphere_roots(const Point3 &center, real radius, const Ray &r, real &root0, real &root1) {
     Vec3 oc = r.origin() - center;              // 射线起点到球体中心
 
     // 求根公式
@@ -54,40 +63,92 @@ bool Sphere::hit(const Ray &r, double t_min, double t_max, hit_record &rec) cons
     auto a = r.direction().length_squared();
     auto half_b = dot(oc, r.direction());
     auto c = oc.length_squared() - radius * radius;
-    auto discriminant = half_b * half_b - a * c;
 
+    // 用 oc 垂直于射线方向的分量计算判别式，避免 half_b * half_b - a * c 的灾难性抵消
+    Vec3 l = oc - (half_b / a) * r.direction();
+    auto discriminant = a * (radius * radius - l.length_squared());
     if (discriminant < 0) return false;
     auto sqrtd = sqrt(discriminant);
 
-    // 找到距离最近的根，并判断是否在可接受的范围内：[0.001, infinity]
-    auto root = (-half_b - sqrtd) / a;
+    // 数值稳定的求根：q 不会发生相减抵消，两个根分别为 q / a 和 c / q
+    auto q = half_b < 0 ? -half_b + sqrtd : -half_b - sqrtd;
+    root0 = q / a;
+    root1 = c / q;
+    if (root0 > root1) std::swap(root0, root1);
+    return true;
+}
+
+// 球体求交的第一阶段：只求 [t_min, t_max] 内最近的根 t。Sphere、moving_sphere 和 sphere_set 共用
+inline bool intersect_sphere(const Point3 &center, real radius, const Ray &r, real t_min, real t_max, real &t) {
+    real root0, root1;
+    if (!sphere_roots(center, radius, r, root0, root1))
+        return false;
+
+    // 找到距离最近的根，并判断是否在可接受的范围内：[t_min, t_max]
+    auto root = root0;
     if (root < t_min || t_max < root) {
-        root = (-half_b + sqrtd) / a;
+        root = root1;
         if (root < t_min || t_max < root)
             return false;
     }
 
-    rec.t = root;
-    rec.p = r.at(rec.t);
+    t = root;
+    return true;
+}
+
+// 球内区间：两个根之间的部分与 [t_min, t_max] 求交
+inline bool sphere_interval(const Point3 &center, real radius, const Ray &r, real t_min, real t_max,
+                            real &t_enter, real &t_exit) {
+    if (!sphere_roots(center, radius, r, t_enter, t_exit))
+        return false;
+    t_enter = fmax(t_enter, t_min);
+    t_exit = fmin(t_exit, t_max);
+    return t_enter < t_exit;
+}
+
+// 第二阶段：只为最近的交点计算交点坐标、法线和 uv (acos / atan2)
+inline void sphere_interaction(const Point3 &center, real radius, const material *mat,
+                               const Ray &r, real t, hit_record &rec) {
+    rec.t = t;
+    rec.p = r.at(t);
     Vec3 outward_normal = (rec.p - center) / radius;
     rec.set_face_normal(r, outward_normal);
-    get_sphere_uv(outward_normal, rec.u, rec.v);
-    rec.mat_ptr = mat_ptr;
+    Sphere::get_sphere_uv(outward_normal, rec.u, rec.v);
+    rec.mat_ptr = mat;
+}
+
+bool Sphere::intersect(const Ray &r, real t_min, real t_max, real &t) const {
+    return intersect_sphere(center, radius, r, t_min, t_max, t);
+}
+
+bool Sphere::interval(const Ray &r, real t_min, real t_max, real &t_enter, real &t_exit) const {
+    return sphere_interval(center, radius, r, t_min, t_max, t_enter, t_exit);
+}
 
+void Sphere::surface_interaction(const Ray &r, real t, hit_record &rec) const {
+    sphere_interaction(center, radius, mat_ptr.get(), r, t, rec);
+}
+
+// Sphere 求交
+bool Sphere::hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
+    real t;
+    if (!intersect(r, t_min, t_max, t))
+        return false;
+    surface_interaction(r, t, rec);
     return true;
 }
 
 // Sphere 包围盒
-bool Sphere::bounding_box(double time0, double time1, aabb &output_box) const {
+bool Sphere::bounding_box(real time0, real time1, aabb &output_box) const {
     output_box = aabb(
             center - Vec3(radius, radius, radius),
             center + Vec3(radius, radius, radius));
     return true;
 }
 
-double Sphere::pdf_value(const Point3 &o, const Vec3 &v) const {
+real Sphere::pdf_value(const Point3 &o, const Vec3 &v) const {
     hit_record rec;
-    if (!this->hit(Ray(o,v),0.001,infinity,rec)){
+    if (!this->hit(Ray(o,v),0,infinity,rec)){
         return 0;
     }
     auto cos_theta_max = sqrt(1 - radius*radius/(center-o).length_squared());
@@ -96,6 +157,17 @@ double Sphere::pdf_value(const Point3 &o, const Vec3 &v) const {
     return 1/solid_angle;
 }
 
+// 球面的法线朝向所有方向
+bool Sphere::emitter_bounds(real time0, real time1, light_bounds &out) const {
+    bounding_box(time0, time1, out.bounds);
+    out.w = Vec3(0, 0, 1);
+    out.phi = 4 * pi * radius * radius;
+    out.cos_theta_o = -1;
+    out.cos_theta_e = 0;
+    out.two_sided = false;
+    return true;
+}
+
 Vec3 Sphere::random(const Point3 &o) const {
     Vec3 diretion = center - o;
     auto distance_squared = diretion.length_squared();
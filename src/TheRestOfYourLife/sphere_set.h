@@ -0,0 +1,220 @@
+//
+// Sphere set: many spheres in structure-of-arrays form under one flat BVH, intersected 4 / 8 at a time.
+//
+
+#ifndef RAY_TRACING_SPHERE_SET_H
+#define RAY_TRACING_SPHERE_SET_H
+
+#include "rtweekend.h"
+
+#include "hittable.h"
+#include "sphere.h"
+#include "bvh.h"
+#include "simd.h"
+
+#include <cstdint>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+// 大量小球的集合。每个球只保存 float 的球心、半径和 16 位材质编号 (18 字节)，
+// 而单独的 Sphere 对象还要带虚表、shared_ptr 和控制块。
+// 数据按 BVH 叶子顺序存放，叶子范围内的球用 floatn 一次测试 4 / 8 个，
+// 只有通过 float 粗测的球才用 real 精确求交，结果和单独的 Sphere 一致。
+// 表面信息 (法线、uv) 只为最近的球计算。
+class sphere_set : public hittable {
+public:
+    sphere_set() {}
+
+    void add(const Point3 &center, real radius, shared_ptr<material> m);
+
+    // 预先分配 n 个球的空间，大量添加时避免数组翻倍增长的复制和多占的内存
+    void reserve(size_t n) {
+        cx.reserve(n + floatn::width - 1);
+        cy.reserve(n + floatn::width - 1);
+        cz.reserve(n + floatn::width - 1);
+        radius.reserve(n + floatn::width - 1);
+        material_id.reserve(n + floatn::width - 1);
+    }
+
+    // 添加完所有球之后调用，建立 BVH 并按叶子顺序重排数据。
+    // 叶子最多 leaf_batches 批 (每批 floatn::width 个球)；上亿个球时用更大的叶子减少节点数，节点占内存的大头
+    void build(int leaf_batches = 2);
+
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override;
+
+    virtual bool intersect(const Ray &r, real t_min, real t_max, real &t) const override {
+        uint32_t index;
+        return nearest_sphere(r, t_min, t_max, index, t);
+    }
+
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override {
+        output_box = bvh.bounding_box();
+        return !bvh.nodes.empty();
+    }
+
+    // 球的数量 (build 之后数组末尾还有补齐用的空位，不能用数组长度)
+    size_t size() const { return spheres; }
+
+    // 球数据和 BVH 节点占用的字节数
+    size_t sphere_bytes() const {
+        return (cx.capacity() + cy.capacity() + cz.capacity() + radius.capacity()) * sizeof(float)
+               + material_id.capacity() * sizeof(uint16_t);
+    }
+
+    size_t bvh_bytes() const {
+        return bvh.nodes.capacity() * sizeof(flat_bvh_node) + bvh.indices.capacity() * sizeof(uint32_t);
+    }
+
+public:
+    std::vector<float> cx, cy, cz;
+    std::vector<float> radius;
+    std::vector<uint16_t> material_id;
+    std::vector<shared_ptr<material>> materials;
+    flat_bvh bvh;
+
+private:
+    Point3 center(size_t i) const { return Point3(cx[i], cy[i], cz[i]); }
+
+    // 遍历 BVH，求最近的球和它的 t
+    bool nearest_sphere(const Ray &r, real t_min, real t_max, uint32_t &nearest, real &nearest_t) const;
+
+    std::unordered_map<const material *, uint16_t> material_ids;    // 只在添加时使用
+    uint16_t current_material = 0;                                  // 上一个球的材质编号
+
+    float max_coordinate = 0;   // 所有球心坐标绝对值 + 半径的最大值，用于估计 float 粗测的误差
+    size_t spheres = 0;
+};
+
+void sphere_set::add(const Point3 &center, real r, shared_ptr<material> m) {
+    // 材质通常成片重复 (同一个 white / ground)，先和上一个球比较，不同时再查表去重
+    if (materials.empty() || materials[current_material] != m) {
+        auto found = material_ids.find(m.get());
+        if (found != material_ids.end()) {
+            current_material = found->second;
+        } else {
+            // 编号只有 16 位，超出时截断会让球悄悄用错材质
+            if (materials.size() > 0xffff)
+                throw std::length_error("Too many materials in sphere_set (at most 65536).");
+            current_material = static_cast<uint16_t>(materials.size());
+            material_ids.emplace(m.get(), current_material);
+            materials.push_back(m);
+        }
+    }
+
+    cx.push_back(static_cast<float>(center.x()));
+    cy.push_back(static_cast<float>(center.y()));
+    cz.push_back(static_cast<float>(center.z()));
+    radius.push_back(static_cast<float>(r));
+    material_id.push_back(current_material);
+    spheres++;
+}
+
+void sphere_set::build(int leaf_batches) {
+    const auto n = size();
+
+    for (size_t i = 0; i < n; i++) {
+        max_coordinate = std::max({max_coordinate, std::fabs(cx[i]) + radius[i],
+                                   std::fabs(cy[i]) + radius[i], std::fabs(cz[i]) + radius[i]});
+    }
+
+    // 包围盒建树时由球心和半径即时计算，不为每个球存一个 aabb
+    bvh.build(n, [&](uint32_t i) {
+        auto c = center(i);
+        Vec3 half(radius[i], radius[i], radius[i]);
+        return aabb(c - half, c + half);
+    }, leaf_batches * floatn::width, floatn::width);
+
+    // 按叶子顺序重排，叶子就是一段连续的下标；末尾补 width - 1 个空位，批量读取不会越界
+    auto reorder = [&](auto &array) {
+        using value_type = typename std::decay<decltype(array)>::type::value_type;
+        std::vector<value_type> ordered(n + floatn::width - 1);
+        for (size_t i = 0; i < n; i++)
+            ordered[i] = array[bvh.indices[i]];
+        array.swap(ordered);
+    };
+    reorder(cx);
+    reorder(cy);
+    reorder(cz);
+    reorder(radius);
+    reorder(material_id);
+
+    // 遍历只用叶子范围，不再需要编号表
+    std::vector<uint32_t>().swap(bvh.indices);
+    std::unordered_map<const material *, uint16_t>().swap(material_ids);
+}
+
+// 遍历时只记录最近的球，表面信息最后算一次
+bool sphere_set::hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
+    uint32_t nearest;
+    real t;
+    if (!nearest_sphere(r, t_min, t_max, nearest, t))
+        return false;
+
+    sphere_interaction(center(nearest), radius[nearest], materials[material_id[nearest]].get(), r, t, rec);
+    return true;
+}
+
+bool sphere_set::nearest_sphere(const Ray &r, real t_min, real t_max, uint32_t &nearest, real &nearest_t) const {
+    const auto &o = r.origin();
+    const auto &d = r.direction();
+
+    const auto a = static_cast<float>(d.length_squared());
+    const auto inv_a = 1 / a;
+
+    // float 粗测只用来筛选候选球：把半径放大到覆盖球心、射线起点转换成 float 的舍入误差，
+    // 保证不会漏掉 real 精度下的交点，多出来的候选由精确求交排除
+    const auto magnitude = max_coordinate + static_cast<float>(std::max({std::fabs(o.x()), std::fabs(o.y()), std::fabs(o.z())}));
+    const auto slack = floatn::splat(magnitude * 1e-6f + 1e-6f);
+
+    const auto ox = floatn::splat(static_cast<float>(o.x()));
+    const auto oy = floatn::splat(static_cast<float>(o.y()));
+    const auto oz = floatn::splat(static_cast<float>(o.z()));
+    const auto dx = floatn::splat(static_cast<float>(d.x()));
+    const auto dy = floatn::splat(static_cast<float>(d.y()));
+    const auto dz = floatn::splat(static_cast<float>(d.z()));
+    const auto inv_a_n = floatn::splat(inv_a);
+    const auto zero = floatn::splat(0);
+
+    return bvh.traverse(r, t_min, t_max, [&](uint32_t first, uint32_t count, real &closest) {
+        bool hit_leaf = false;
+        const auto t_lo = floatn::splat(static_cast<float>(t_min));
+
+        for (uint32_t base = first; base < first + count; base += floatn::width) {
+            const auto t_hi = floatn::splat(static_cast<float>(closest));
+
+            auto ocx = ox - floatn::load(&cx[base]);
+            auto ocy = oy - floatn::load(&cy[base]);
+            auto ocz = oz - floatn::load(&cz[base]);
+            auto rr = floatn::load(&radius[base]) + slack;
+
+            // 与 Sphere 相同的判别式：oc 垂直于射线方向的分量 l，disc = r^2 - |l|^2，根为 -k ± sqrt(disc / a)
+            auto k = (ocx * dx + ocy * dy + ocz * dz) * inv_a_n;
+            auto lx = ocx - k * dx;
+            auto ly = ocy - k * dy;
+            auto lz = ocz - k * dz;
+            auto disc = rr * rr - (lx * lx + ly * ly + lz * lz);
+            auto s = sqrt_clamped(disc * inv_a_n);
+
+            auto mask = (disc >= zero) & ((zero - k + s) >= t_lo) & ((zero - k - s) <= t_hi);
+
+            int bits = movemask(mask);
+            const auto remaining = first + count - base;
+            if (remaining < static_cast<uint32_t>(floatn::width))
+                bits &= (1 << remaining) - 1;
+
+            for (uint32_t i = base; bits; i++, bits >>= 1) {
+                real t;
+                if ((bits & 1) && intersect_sphere(center(i), radius[i], r, t_min, closest, t)) {
+                    hit_leaf = true;
+                    closest = nearest_t = t;
+                    nearest = i;
+                }
+            }
+        }
+
+        return hit_leaf;
+    });
+}
+
+#endif //RAY_TRACING_SPHERE_SET_H
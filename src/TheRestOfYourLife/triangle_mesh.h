@@ -0,0 +1,581 @@
+//
+// Indexed triangle mesh: shared vertex / normal / uv buffers under one flat BVH.
+//
+
+#ifndef RAY_TRACING_TRIANGLE_MESH_H
+#define RAY_TRACING_TRIANGLE_MESH_H
+
+#include "rtweekend.h"
+
+#include "hittable.h"
+#include "bvh.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// 水密求交 (Woop, Benthin, Wald 2013) 的逐射线常量：方向分量绝对值最大的轴为 kz，
+// 把射线剪切变换成沿 +z 的单位射线，三角形的边函数只和顶点的坐标有关，
+// 共享一条边的两个三角形对同一条射线算出相同的边函数，射线不会从边上漏过去
+struct watertight_ray {
+    explicit watertight_ray(const Ray &r) {
+        const auto &d = r.direction();
+        kz = fabs(d.x()) > fabs(d.y()) ? (fabs(d.x()) > fabs(d.z()) ? 0 : 2) : (fabs(d.y()) > fabs(d.z()) ? 1 : 2);
+        kx = (kz + 1) % 3;
+        ky = (kx + 1) % 3;
+        if (d[kz] < 0)      // 保持三角形的绕向
+            std::swap(kx, ky);
+        sx = d[kx] / d[kz];
+        sy = d[ky] / d[kz];
+        sz = 1 / d[kz];
+    }
+
+    int kx, ky, kz;
+    real sx, sy, sz;
+};
+
+// 水密的射线-三角形求交，返回 [t_min, t_max] 内的 t 和重心坐标 (b1, b2)，
+// 交点为 (1 - b1 - b2) p0 + b1 p1 + b2 p2
+inline bool intersect_triangle_watertight(const Point3 &p0, const Point3 &p1, const Point3 &p2, const Ray &r,
+                                          const watertight_ray &w, real t_min, real t_max,
+                                          real &t, real &b1, real &b2) {
+    auto a = p0 - r.origin();
+    auto b = p1 - r.origin();
+    auto c = p2 - r.origin();
+    auto ax = a[w.kx] - w.sx * a[w.kz], ay = a[w.ky] - w.sy * a[w.kz];
+    auto bx = b[w.kx] - w.sx * b[w.kz], by = b[w.ky] - w.sy * b[w.kz];
+    auto cx = c[w.kx] - w.sx * c[w.kz], cy = c[w.ky] - w.sy * c[w.kz];
+
+    // 三条边函数，同号时射线穿过三角形
+    auto e0 = cx * by - cy * bx;
+    auto e1 = ax * cy - ay * cx;
+    auto e2 = bx * ay - by * ax;
+    if ((e0 < 0 || e1 < 0 || e2 < 0) && (e0 > 0 || e1 > 0 || e2 > 0))
+        return false;
+
+    auto det = e0 + e1 + e2;
+    if (det == 0)
+        return false;
+
+    auto scaled_t = w.sz * (e0 * a[w.kz] + e1 * b[w.kz] + e2 * c[w.kz]);
+    auto root = scaled_t / det;
+    if (root < t_min || root > t_max)
+        return false;
+
+    t = root;
+    b1 = e1 / det;
+    b2 = e2 / det;
+    return true;
+}
+
+// 单位向量的八面体编码 (Cigolle et al. 2014)：投影到 |x| + |y| + |z| = 1 的八面体上，
+// 下半部分折叠到上半部分外侧，两个坐标各量化为 16 位，解码误差约 1e-4 弧度
+inline uint32_t oct_encode(const Vec3 &n) {
+    const auto l1 = fabs(n.x()) + fabs(n.y()) + fabs(n.z());
+    real x = l1 > 0 ? n.x() / l1 : 0;
+    real y = l1 > 0 ? n.y() / l1 : 0;
+    if (n.z() < 0) {
+        const auto fx = (1 - fabs(y)) * (x >= 0 ? 1 : -1);
+        const auto fy = (1 - fabs(x)) * (y >= 0 ? 1 : -1);
+        x = fx;
+        y = fy;
+    }
+    const auto qx = static_cast<int16_t>(std::lround(clamp(x, -1, 1) * 32767));
+    const auto qy = static_cast<int16_t>(std::lround(clamp(y, -1, 1) * 32767));
+    return static_cast<uint32_t>(static_cast<uint16_t>(qx)) | static_cast<uint32_t>(static_cast<uint16_t>(qy)) << 16;
+}
+
+inline Vec3 oct_decode(uint32_t packed) {
+    real x = static_cast<int16_t>(packed & 0xffff) / real(32767);
+    real y = static_cast<int16_t>(packed >> 16) / real(32767);
+    const auto z = 1 - fabs(x) - fabs(y);
+    if (z < 0) {
+        const auto fx = (1 - fabs(y)) * (x >= 0 ? 1 : -1);
+        const auto fy = (1 - fabs(x)) * (y >= 0 ? 1 : -1);
+        x = fx;
+        y = fy;
+    }
+    return unit_vector(Vec3(x, y, z));
+}
+
+// 三角网格。顶点、法线、uv 各自保存在共享的 float 数组里，每个三角形只保存 3 个下标，
+// 与 OBJ 一样三种属性可以有各自的下标 (没有法线或 uv 时对应的数组为空)。
+// 三角形按 BVH 叶子顺序存放，叶子就是一段连续的三角形，不再为每个三角形分配对象。
+// 求交用另存的 SoA 顶点坐标，叶子内的三角形用 floatn 一次测试 4 / 8 个 (水密测试的边函数)，
+// float 粗测带误差余量，只有通过的三角形才用 real 精确求交，结果与逐个调用 intersect_triangle_watertight 一致。
+// 整个网格一个材质。
+//
+// 压缩存储 (build(true))：每个 BVH 叶子为一簇，顶点吸附到全局网格上，
+// 保存为相对簇原点的 16 位网格坐标；法线八面体编码、uv 量化为 16 位，按三角形的顶点逐个保存，
+// 不再需要下标。求交和着色时即时解码。同一个顶点在不同的簇里解码出同一个坐标，网格仍然水密。
+class triangle_mesh : public hittable {
+public:
+    triangle_mesh() {}
+
+    explicit triangle_mesh(shared_ptr<material> m) : mat_ptr(m) {}
+
+    // 填好顶点和下标之后调用，建立 BVH 并按叶子顺序重排三角形。quantize 为 true 时改用压缩存储，
+    // 填入的 float 数组和下标全部释放
+    void build(bool quantize = false);
+
+    virtual bool hit(const Ray &r, real t_min, real t_max, hit_record &rec) const override;
+
+    virtual bool intersect(const Ray &r, real t_min, real t_max, real &t) const override {
+        uint32_t tri;
+        real b1, b2;
+        return nearest_triangle(r, t_min, t_max, tri, t, b1, b2);
+    }
+
+    virtual bool bounding_box(real time0, real time1, aabb &output_box) const override {
+        output_box = bvh.bounding_box();
+        return !bvh.nodes.empty();
+    }
+
+    size_t triangle_count() const { return triangles; }
+
+    size_t vertex_count() const { return vertices; }
+
+    bool is_quantized() const { return quantized; }
+
+    // 填入的第 i 个顶点，build 之前或者未压缩时可用
+    Point3 vertex(uint32_t i) const {
+        return Point3(positions[3 * i], positions[3 * i + 1], positions[3 * i + 2]);
+    }
+
+    // 叶子顺序下第 tri 个三角形的第 k 个顶点 (build 之后可用)
+    Point3 triangle_vertex(uint32_t tri, int k) const {
+        if (quantized)
+            return quantized_vertex(cluster_of(tri), tri, k);
+        return Point3(corner[k][0][tri], corner[k][1][tri], corner[k][2][tri]);
+    }
+
+    // 顶点属性和下标占用的字节数
+    size_t mesh_bytes() const {
+        return (positions.capacity() + normals.capacity() + uvs.capacity()) * sizeof(float)
+               + (position_index.capacity() + normal_index.capacity() + uv_index.capacity()
+                  + qnormal.capacity() + quv.capacity()) * sizeof(uint32_t);
+    }
+
+    // 求交用的 SoA 顶点坐标
+    size_t packed_bytes() const {
+        size_t bytes = cluster_origin.capacity() * sizeof(int32_t)
+                       + (cluster_first.capacity() + cluster_lookup.capacity()) * sizeof(uint32_t);
+        for (int k = 0; k < 3; k++) {
+            for (int axis = 0; axis < 3; axis++)
+                bytes += corner[k][axis].capacity() * sizeof(float) + qcorner[k][axis].capacity() * sizeof(uint16_t);
+        }
+        return bytes;
+    }
+
+    size_t bvh_bytes() const {
+        return bvh.nodes.capacity() * sizeof(flat_bvh_node) + bvh.indices.capacity() * sizeof(uint32_t);
+    }
+
+public:
+    std::vector<float> positions;           // x, y, z
+    std::vector<float> normals;             // x, y, z
+    std::vector<float> uvs;                 // u, v
+    std::vector<uint32_t> position_index;   // 每个三角形 3 个
+    std::vector<uint32_t> normal_index;     // 每个三角形 3 个，或者为空
+    std::vector<uint32_t> uv_index;         // 每个三角形 3 个，或者为空
+    shared_ptr<material> mat_ptr;
+    flat_bvh bvh;
+
+    // corner[k][axis][i]：叶子顺序下第 i 个三角形第 k 个顶点的 axis 坐标，末尾补 width - 1 个空位
+    std::vector<float> corner[3][3];
+
+private:
+    // 把 build 填好的 float 数组转换为压缩存储
+    void quantize_storage();
+
+    // 遍历 BVH，求最近的三角形、t 和重心坐标。按存储方式实例化两份，内层循环里没有分支
+    bool nearest_triangle(const Ray &r, real t_min, real t_max, uint32_t &nearest, real &nearest_t,
+                          real &b1, real &b2) const {
+        return quantized ? nearest_triangle<true>(r, t_min, t_max, nearest, nearest_t, b1, b2)
+                         : nearest_triangle<false>(r, t_min, t_max, nearest, nearest_t, b1, b2);
+    }
+
+    template<bool Quantized>
+    bool nearest_triangle(const Ray &r, real t_min, real t_max, uint32_t &nearest, real &nearest_t,
+                          real &b1, real &b2) const;
+
+    void surface_interaction(const Ray &r, uint32_t tri, real t, real b1, real b2, hit_record &rec) const;
+
+    // 三角形所在的簇：先查所在的 8 个三角形一段的第一个簇，再向后找 (叶子一般有 4 个以上三角形，很少超过一步)
+    uint32_t cluster_of(uint32_t tri) const {
+        auto c = cluster_lookup[tri / 8];
+        while (c + 1 < cluster_first.size() && cluster_first[c + 1] <= tri)
+            c++;
+        return c;
+    }
+
+    // 解码：网格坐标 = 簇原点 + 偏移，同一个网格坐标总是得到同一个 real
+    Point3 quantized_vertex(uint32_t cluster, uint32_t tri, int k) const {
+        const auto *origin = &cluster_origin[3 * cluster];
+        return Point3(grid_origin.x() + static_cast<real>(origin[0] + qcorner[k][0][tri]) * grid_cell,
+                      grid_origin.y() + static_cast<real>(origin[1] + qcorner[k][1][tri]) * grid_cell,
+                      grid_origin.z() + static_cast<real>(origin[2] + qcorner[k][2][tri]) * grid_cell);
+    }
+
+    bool has_normals() const { return !normal_index.empty() || !qnormal.empty(); }
+
+    bool has_uvs() const { return !uv_index.empty() || !quv.empty(); }
+
+    Vec3 corner_normal(uint32_t tri, int k) const {
+        if (quantized)
+            return oct_decode(qnormal[3 * tri + k]);
+        auto i = normal_index[3 * tri + k];
+        return Vec3(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]);
+    }
+
+    void corner_uv(uint32_t tri, int k, real &u, real &v) const {
+        if (quantized) {
+            const auto packed = quv[3 * tri + k];
+            u = uv_min[0] + (packed & 0xffff) * uv_step[0];
+            v = uv_min[1] + (packed >> 16) * uv_step[1];
+            return;
+        }
+        auto i = uv_index[3 * tri + k];
+        u = uvs[2 * i];
+        v = uvs[2 * i + 1];
+    }
+
+private:
+    size_t triangles = 0;
+    size_t vertices = 0;
+    float max_coordinate = 0;   // 所有顶点坐标绝对值的最大值，用于估计 float 粗测的误差
+
+    // 压缩存储
+    bool quantized = false;
+    std::vector<uint16_t> qcorner[3][3];    // 与 corner 相同的布局，相对所在簇原点的网格坐标
+    std::vector<uint32_t> cluster_first;    // 每簇第一个三角形，递增
+    std::vector<uint32_t> cluster_lookup;   // 每 8 个三角形一项：第一个三角形所在的簇
+    std::vector<int32_t> cluster_origin;    // 每簇 3 个网格坐标
+    Point3 grid_origin;
+    real grid_cell = 1;                     // 网格间距
+    std::vector<uint32_t> qnormal;          // 每个三角形 3 个八面体编码的法线，或者为空
+    std::vector<uint32_t> quv;              // 每个三角形 3 个 uv (u 低 16 位，v 高 16 位)，或者为空
+    real uv_min[2] = {0, 0};
+    real uv_step[2] = {1, 1};
+};
+
+void triangle_mesh::build(bool quantize) {
+    const auto n = position_index.size() / 3;
+    triangles = n;
+    vertices = positions.size() / 3;
+
+    std::vector<aabb> bounds(n);
+    for (size_t i = 0; i < n; i++) {
+        auto p0 = vertex(position_index[3 * i]);
+        auto p1 = vertex(position_index[3 * i + 1]);
+        auto p2 = vertex(position_index[3 * i + 2]);
+        Point3 lo(fmin(p0.x(), fmin(p1.x(), p2.x())), fmin(p0.y(), fmin(p1.y(), p2.y())), fmin(p0.z(), fmin(p1.z(), p2.z())));
+        Point3 hi(fmax(p0.x(), fmax(p1.x(), p2.x())), fmax(p0.y(), fmax(p1.y(), p2.y())), fmax(p0.z(), fmax(p1.z(), p2.z())));
+        bounds[i] = aabb(lo, hi).padded();
+    }
+
+    // SAH 按 floatn 的批数计算叶子代价，叶子会填满 4 / 8 个三角形
+    bvh.build(bounds, 2 * floatn::width, floatn::width);
+    std::vector<aabb>().swap(bounds);
+
+    // 按叶子顺序重排三角形的下标，叶子就是一段连续的三角形
+    auto reorder = [&](std::vector<uint32_t> &index) {
+        if (index.empty())
+            return;
+        std::vector<uint32_t> ordered(index.size());
+        for (size_t i = 0; i < n; i++) {
+            for (int k = 0; k < 3; k++)
+                ordered[3 * i + k] = index[3 * bvh.indices[i] + k];
+        }
+        index.swap(ordered);
+    };
+    reorder(position_index);
+    reorder(normal_index);
+    reorder(uv_index);
+
+    // 遍历只用叶子范围，不再需要编号表
+    std::vector<uint32_t>().swap(bvh.indices);
+
+    max_coordinate = 0;
+    for (auto x: positions)
+        max_coordinate = std::max(max_coordinate, std::fabs(x));
+
+    if (quantize) {
+        quantize_storage();
+        return;
+    }
+
+    for (int k = 0; k < 3; k++) {
+        for (int axis = 0; axis < 3; axis++) {
+            auto &coords = corner[k][axis];
+            coords.assign(n + floatn::width - 1, 0.0f);
+            for (size_t i = 0; i < n; i++)
+                coords[i] = positions[3 * position_index[3 * i + k] + axis];
+        }
+    }
+}
+
+void triangle_mesh::quantize_storage() {
+    const auto n = triangles;
+    quantized = true;
+    if (n == 0)
+        return;
+
+    // 簇就是叶子：遍历时一个叶子内的三角形共用一个簇原点
+    std::vector<std::pair<uint32_t, uint32_t>> leaves;
+    for (const auto &node: bvh.nodes) {
+        if (node.count > 0)
+            leaves.emplace_back(node.offset, node.count);
+    }
+    std::sort(leaves.begin(), leaves.end());
+    const auto clusters = leaves.size();
+
+    // 网格间距：最大的簇在每个轴上不超过 65534 格 (吸附时的舍入再占 1 格)，
+    // 整个网格的网格坐标不超过 2^30，簇原点加偏移不会溢出
+    Point3 lo(infinity, infinity, infinity), hi(-infinity, -infinity, -infinity);
+    real largest_cluster = 0;
+    for (const auto &leaf: leaves) {
+        Point3 cluster_lo(infinity, infinity, infinity), cluster_hi(-infinity, -infinity, -infinity);
+        for (uint32_t i = leaf.first; i < leaf.first + leaf.second; i++) {
+            for (int k = 0; k < 3; k++) {
+                auto p = vertex(position_index[3 * i + k]);
+                for (int axis = 0; axis < 3; axis++) {
+                    cluster_lo[axis] = fmin(cluster_lo[axis], p[axis]);
+                    cluster_hi[axis] = fmax(cluster_hi[axis], p[axis]);
+                }
+            }
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            largest_cluster = fmax(largest_cluster, cluster_hi[axis] - cluster_lo[axis]);
+            lo[axis] = fmin(lo[axis], cluster_lo[axis]);
+            hi[axis] = fmax(hi[axis], cluster_hi[axis]);
+        }
+    }
+    const auto extent = fmax(hi.x() - lo.x(), fmax(hi.y() - lo.y(), hi.z() - lo.z()));
+    grid_origin = lo;
+    grid_cell = fmax(largest_cluster / 65534, extent / (1 << 30));
+    if (grid_cell <= 0)
+        grid_cell = 1;
+
+    // 吸附到网格会让顶点移动至多半格，节点包围盒是用原始坐标算的，各向外扩一格才能包住解码后的三角形，
+    // 否则擦过轮廓边的射线可能跳过实际打中的节点
+    const Vec3 snap(grid_cell, grid_cell, grid_cell);
+    for (auto &node: bvh.nodes)
+        node.box = aabb(node.box.min() - snap, node.box.max() + snap);
+
+    auto grid = [&](uint32_t v, int axis) {
+        return static_cast<int32_t>(std::lround((positions[3 * v + axis] - grid_origin[axis]) / grid_cell));
+    };
+
+    cluster_first.resize(clusters);
+    cluster_origin.assign(3 * clusters, INT32_MAX);
+    for (int k = 0; k < 3; k++) {
+        for (int axis = 0; axis < 3; axis++)
+            qcorner[k][axis].assign(n + floatn::width - 1, 0);
+    }
+    for (size_t c = 0; c < clusters; c++) {
+        const auto first = leaves[c].first, last = leaves[c].first + leaves[c].second;
+        auto *origin = &cluster_origin[3 * c];
+        cluster_first[c] = first;
+        for (auto i = first; i < last; i++) {
+            for (int k = 0; k < 3; k++) {
+                for (int axis = 0; axis < 3; axis++)
+                    origin[axis] = std::min(origin[axis], grid(position_index[3 * i + k], axis));
+            }
+        }
+        for (auto i = first; i < last; i++) {
+            for (int k = 0; k < 3; k++) {
+                for (int axis = 0; axis < 3; axis++)
+                    qcorner[k][axis][i] = static_cast<uint16_t>(grid(position_index[3 * i + k], axis) - origin[axis]);
+            }
+        }
+    }
+    cluster_lookup.resize((n + 7) / 8);
+    for (size_t c = 0; c < clusters; c++) {
+        for (auto i = (cluster_first[c] + 7) / 8 * 8; i < leaves[c].first + leaves[c].second; i += 8)
+            cluster_lookup[i / 8] = static_cast<uint32_t>(c);
+    }
+    max_coordinate += static_cast<float>(grid_cell);
+
+    if (!normal_index.empty()) {
+        qnormal.resize(3 * n);
+        for (size_t j = 0; j < 3 * n; j++) {
+            auto i = normal_index[j];
+            qnormal[j] = oct_encode(Vec3(normals[3 * i], normals[3 * i + 1], normals[3 * i + 2]));
+        }
+    }
+
+    // uv 相对整个网格的 uv 范围量化
+    if (!uv_index.empty()) {
+        for (int axis = 0; axis < 2; axis++) {
+            real uv_lo = infinity, uv_hi = -infinity;
+            for (size_t i = axis; i < uvs.size(); i += 2) {
+                uv_lo = fmin(uv_lo, uvs[i]);
+                uv_hi = fmax(uv_hi, uvs[i]);
+            }
+            uv_min[axis] = uv_lo;
+            uv_step[axis] = uv_hi > uv_lo ? (uv_hi - uv_lo) / 65535 : 1;
+        }
+        quv.resize(3 * n);
+        for (size_t j = 0; j < 3 * n; j++) {
+            auto i = uv_index[j];
+            uint32_t q[2];
+            for (int axis = 0; axis < 2; axis++)
+                q[axis] = static_cast<uint32_t>(std::lround((uvs[2 * i + axis] - uv_min[axis]) / uv_step[axis]));
+            quv[j] = q[0] | q[1] << 16;
+        }
+    }
+
+    std::vector<float>().swap(positions);
+    std::vector<float>().swap(normals);
+    std::vector<float>().swap(uvs);
+    std::vector<uint32_t>().swap(position_index);
+    std::vector<uint32_t>().swap(normal_index);
+    std::vector<uint32_t>().swap(uv_index);
+}
+
+template<bool Quantized>
+bool triangle_mesh::nearest_triangle(const Ray &r, real t_min, real t_max, uint32_t &nearest, real &nearest_t,
+                                     real &b1, real &b2) const {
+    const watertight_ray w(r);
+    const auto &o = r.origin();
+
+    // float 粗测的误差余量：剪切后的坐标误差不超过 delta，边函数 (两个乘积之差) 的误差按
+    // delta x 坐标大小 + 乘积的舍入放大，保证 real 精度下穿过的三角形不会被漏掉。
+    // 压缩存储时在网格单位下计算，边函数整体差一个正的倍数，符号不变
+    auto magnitude = max_coordinate + static_cast<float>(std::max({std::fabs(o.x()), std::fabs(o.y()), std::fabs(o.z())}));
+    if (Quantized)
+        magnitude /= static_cast<float>(grid_cell);
+    const auto delta = floatn::splat(magnitude * 1e-6f + 1e-6f);
+    const auto rounding = floatn::splat(1e-6f);
+
+    const floatn origin[3] = {floatn::splat(static_cast<float>(o[0])), floatn::splat(static_cast<float>(o[1])),
+                              floatn::splat(static_cast<float>(o[2]))};
+    const auto sx = floatn::splat(static_cast<float>(w.sx));
+    const auto sy = floatn::splat(static_cast<float>(w.sy));
+    const Vec3 grid_to_ray = (grid_origin - o) / grid_cell;     // 射线起点到网格原点，网格单位
+
+    return bvh.traverse(r, t_min, t_max, [&](uint32_t first, uint32_t count, real &closest) {
+        bool hit_leaf = false;
+
+        // 压缩存储时，簇原点相对射线起点的位置剪切后用 real 计算，再转为 float
+        uint32_t c = 0;
+        floatn shear_x, shear_y;
+        if (Quantized) {
+            c = cluster_of(first);
+            const auto *cluster = &cluster_origin[3 * c];
+            const auto z = grid_to_ray[w.kz] + cluster[w.kz];
+            shear_x = floatn::splat(static_cast<float>(grid_to_ray[w.kx] + cluster[w.kx] - w.sx * z));
+            shear_y = floatn::splat(static_cast<float>(grid_to_ray[w.ky] + cluster[w.ky] - w.sy * z));
+        }
+        auto corner_vertex = [&](uint32_t i, int k) {
+            return Quantized ? quantized_vertex(c, i, k) : Point3(corner[k][0][i], corner[k][1][i], corner[k][2][i]);
+        };
+
+        for (uint32_t base = first; base < first + count; base += floatn::width) {
+            // 三个顶点平移到射线起点并剪切
+            floatn x[3], y[3];
+            for (int k = 0; k < 3; k++) {
+                if (Quantized) {
+                    auto z = floatn::load_u16(&qcorner[k][w.kz][base]);
+                    x[k] = floatn::load_u16(&qcorner[k][w.kx][base]) - sx * z + shear_x;
+                    y[k] = floatn::load_u16(&qcorner[k][w.ky][base]) - sy * z + shear_y;
+                } else {
+                    auto z = floatn::load(&corner[k][w.kz][base]) - origin[w.kz];
+                    x[k] = floatn::load(&corner[k][w.kx][base]) - origin[w.kx] - sx * z;
+                    y[k] = floatn::load(&corner[k][w.ky][base]) - origin[w.ky] - sy * z;
+                }
+            }
+
+            // 边函数 e_k 对应顶点 k 对面的边
+            floatn inside_pos = floatn::splat(0) <= floatn::splat(0);
+            floatn inside_neg = inside_pos;
+            for (int k = 0; k < 3; k++) {
+                const int i = (k + 1) % 3, j = (k + 2) % 3;
+                auto pi = x[j] * y[i];
+                auto pj = y[j] * x[i];
+                auto e = pi - pj;
+                auto tol = delta * (abs(x[i]) + abs(y[i]) + abs(x[j]) + abs(y[j])) + rounding * (abs(pi) + abs(pj));
+                inside_pos = inside_pos & (e >= floatn::splat(0) - tol);
+                inside_neg = inside_neg & (e <= tol);
+            }
+
+            int bits = movemask(inside_pos | inside_neg);
+            const auto remaining = first + count - base;
+            if (remaining < static_cast<uint32_t>(floatn::width))
+                bits &= (1 << remaining) - 1;
+
+            for (uint32_t i = base; bits; i++, bits >>= 1) {
+                real t, u, v;
+                if ((bits & 1) && intersect_triangle_watertight(corner_vertex(i, 0), corner_vertex(i, 1), corner_vertex(i, 2),
+                                                                r, w, t_min, closest, t, u, v)) {
+                    hit_leaf = true;
+                    closest = nearest_t = t;
+                    nearest = i;
+                    b1 = u;
+                    b2 = v;
+                }
+            }
+        }
+
+        return hit_leaf;
+    });
+}
+
+// 遍历时只记录最近的三角形，法线和 uv 最后插值一次
+bool triangle_mesh::hit(const Ray &r, real t_min, real t_max, hit_record &rec) const {
+    uint32_t tri;
+    real t, b1, b2;
+    if (!nearest_triangle(r, t_min, t_max, tri, t, b1, b2))
+        return false;
+
+    surface_interaction(r, tri, t, b1, b2, rec);
+    return true;
+}
+
+void triangle_mesh::surface_interaction(const Ray &r, uint32_t tri, real t, real b1, real b2, hit_record &rec) const {
+    const auto b0 = 1 - b1 - b2;
+    auto p0 = triangle_vertex(tri, 0);
+    auto p1 = triangle_vertex(tri, 1);
+    auto p2 = triangle_vertex(tri, 2);
+
+    rec.t = t;
+    rec.p = b0 * p0 + b1 * p1 + b2 * p2;    // 用重心坐标插值，交点落在三角形平面上
+
+    // 正反面由几何法线决定 (逆时针为正面)。有顶点法线时插值作为着色法线，
+    // 几何法线翻到着色法线一侧：掠射时插值法线可能背向射线，不能用它判断正反面
+    auto outward_normal = unit_vector(cross(p1 - p0, p2 - p0));
+    if (has_normals()) {
+        Vec3 n(0, 0, 0);
+        const real w[3] = {b0, b1, b2};
+        for (int k = 0; k < 3; k++)
+            n += w[k] * corner_normal(tri, k);
+        auto shading_normal = unit_vector(n);
+        if (dot(shading_normal, outward_normal) < 0)
+            outward_normal = -outward_normal;
+        rec.front_face = dot(r.direction(), outward_normal) < 0;
+        rec.normal = rec.front_face ? shading_normal : -shading_normal;
+    } else {
+        rec.set_face_normal(r, outward_normal);
+    }
+
+    // 没有 uv 时直接用重心坐标
+    if (has_uvs()) {
+        const real w[3] = {b0, b1, b2};
+        rec.u = rec.v = 0;
+        for (int k = 0; k < 3; k++) {
+            real u, v;
+            corner_uv(tri, k, u, v);
+            rec.u += w[k] * u;
+            rec.v += w[k] * v;
+        }
+    } else {
+        rec.u = b1;
+        rec.v = b2;
+    }
+
+    rec.mat_ptr = mat_ptr.get();
+}
+
+#endif //RAY_TRACING_TRIANGLE_MESH_H
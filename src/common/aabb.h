@@ -8,6 +8,9 @@
 
 #include "rtweekend.h"
 
+// slab 测试离开距离的放大系数，1 + 2 * gamma(3)
+const real slab_exit_scale = 1 + 3 * std::numeric_limits<real>::epsilon();
+
 class aabb {
 public:
     aabb() = default;
@@ -22,37 +25,45 @@ public:
 
     Point3 max() const { return maximum; }
 
-    // 传入射线、起点距离、最大距离，判断是射线否与 AABB 相交
-    bool hit(const Ray &r, double t_min, double t_max) const {
+    // 不包含任何点的包围盒，与任意包围盒合并得到后者
+    static aabb empty() {
+        return aabb(Point3(infinity, infinity, infinity), Point3(-infinity, -infinity, -infinity));
+    }
+
+    Point3 center() const { return 0.5 * (minimum + maximum); }
 
-        // 检查射线在三个维度上的重叠情况
-        for (int i = 0; i < 3; i++) {
-            auto t0 = fmin(
-                    (minimum[i] - r.origin()[i]) / r.direction()[i],
-                    (maximum[i] - r.origin()[i]) / r.direction()[i]);
-            auto t1 = fmax(
-                    (minimum[i] - r.origin()[i]) / r.direction()[i],
-                    (maximum[i] - r.origin()[i]) / r.direction()[i]);
-            t_min = fmax(t0, t_min);
-            t_max = fmin(t1, t_max);
-            if (t_max <= t_min)
-                return false;
+    // 表面积，用于 SAH 代价估计
+    real surface_area() const {
+        auto d = maximum - minimum;
+        return 2 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+    }
+
+    // 包围盒每个维度都必须有非零厚度，按坐标量级扩展退化的维度 (取代固定的 0.0001)
+    aabb padded() const {
+        Point3 lo = minimum;
+        Point3 hi = maximum;
+        for (int a = 0; a < 3; a++) {
+            auto delta = ray_offset_scale * (fmax(fabs(lo[a]), fabs(hi[a])) + 1);
+            if (hi[a] - lo[a] < delta) {
+                lo[a] -= delta;
+                hi[a] += delta;
+            }
         }
-        return true;
+        return aabb(lo, hi);
+    }
 
-        // 重叠检查优化版本
+    // 传入射线、起点距离、最大距离，判断是射线否与 AABB 相交。
+    // 用射线预先算好的方向倒数和符号位做 slab 测试，没有除法和分支。
+    // 方向分量为 0 且起点恰好在边界上时 0 * inf 得到 NaN：比较写成 t0 > t_min ? t0 : t_min，
+    // NaN 比较为假，这个轴不收缩区间。离开距离按 1 + 3 eps 放大，抵消舍入误差，不会漏掉擦边的射线
+    bool hit(const Ray &r, real t_min, real t_max) const {
         for (int a = 0; a < 3; a++) {
-            auto invD = 1.0f / r.direction()[a];
-            auto t0 = (min()[a] - r.origin()[a]) * invD;
-            auto t1 = (max()[a] - r.origin()[a]) * invD;
-            if (invD < 0.0f)
-                std::swap(t0, t1);
+            auto t0 = ((r.sign[a] ? maximum : minimum)[a] - r.orig[a]) * r.inv_dir[a];
+            auto t1 = ((r.sign[a] ? minimum : maximum)[a] - r.orig[a]) * r.inv_dir[a] * slab_exit_scale;
             t_min = t0 > t_min ? t0 : t_min;
             t_max = t1 < t_max ? t1 : t_max;
-            if (t_max <= t_min)
-                return false;
         }
-        return true;
+        return t_min <= t_max;
     }
 
     Point3 minimum;
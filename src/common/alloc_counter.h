@@ -0,0 +1,58 @@
+//
+// Heap allocation counter.
+// 替换全局 operator new / delete 并统计分配次数，用来验证渲染循环在稳定状态下没有堆分配。
+// 只能在一个编译单元 (main.cpp) 中包含。
+//
+
+#ifndef RAY_TRACING_ALLOC_COUNTER_H
+#define RAY_TRACING_ALLOC_COUNTER_H
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+std::atomic<size_t> heap_allocation_count(0);
+
+// 程序启动以来的堆分配次数
+inline size_t heap_allocations() {
+    return heap_allocation_count.load(std::memory_order_relaxed);
+}
+
+// 分配和释放函数不内联：GCC 内联后会看到 free 释放的是 operator new 返回的指针，报告 -Wmismatched-new-delete
+#if defined(_MSC_VER)
+#define ALLOC_COUNTER_NOINLINE __declspec(noinline)
+#else
+#define ALLOC_COUNTER_NOINLINE __attribute__((noinline))
+#endif
+
+ALLOC_COUNTER_NOINLINE void *operator new(size_t size) {
+    heap_allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0)
+        size = 1;
+    if (void *p = std::malloc(size))
+        return p;
+    throw std::bad_alloc();
+}
+
+ALLOC_COUNTER_NOINLINE void operator delete(void *p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    operator delete(p);
+}
+
+// 数组版本同样计数，释放都转给上面的 operator delete
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete[](void *p) noexcept {
+    operator delete(p);
+}
+
+void operator delete[](void *p, size_t) noexcept {
+    operator delete(p);
+}
+
+#endif //RAY_TRACING_ALLOC_COUNTER_H
@@ -0,0 +1,138 @@
+//
+// Scene arena: bump allocator for primitives, materials and textures.
+//
+
+#ifndef RAY_TRACING_ARENA_H
+#define RAY_TRACING_ARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+// 按块分配的线性内存池：分配只移动指针，单个对象的释放是空操作，
+// 析构时一次性归还所有块。场景里成千上万个小对象因此连续存放，构建时也不再逐个调用 malloc。
+// 池必须比从中分配的所有对象活得更久。
+class arena {
+public:
+    explicit arena(size_t block_size = 256 * 1024) : block_size(block_size) {}
+
+    arena(const arena &) = delete;
+
+    arena &operator=(const arena &) = delete;
+
+    ~arena() {
+        for (auto block: blocks)
+            std::free(block);
+    }
+
+    void *allocate(size_t size, size_t alignment) {
+        // 超过块大小的对象单独占一块，当前块剩下的空间留给之后的小对象
+        if (size + alignment > block_size) {
+            auto block = new_block(size + alignment);
+            used += size;
+            return reinterpret_cast<void *>((reinterpret_cast<uintptr_t>(block) + alignment - 1) & ~(alignment - 1));
+        }
+
+        auto aligned = (current + alignment - 1) & ~(alignment - 1);
+        if (aligned + size > end) {
+            current = reinterpret_cast<uintptr_t>(new_block(block_size));
+            end = current + block_size;
+            aligned = (current + alignment - 1) & ~(alignment - 1);
+        }
+
+        current = aligned + size;
+        used += size;
+        return reinterpret_cast<void *>(aligned);
+    }
+
+    size_t bytes_used() const { return used; }
+
+    size_t bytes_reserved() const { return reserved; }
+
+    // 向 malloc 申请的块数 (不经过 operator new，堆分配计数里没有)
+    size_t block_count() const { return blocks.size(); }
+
+private:
+    char *new_block(size_t bytes) {
+        auto block = static_cast<char *>(std::malloc(bytes));
+        if (!block)
+            throw std::bad_alloc();
+        blocks.push_back(block);
+        reserved += bytes;
+        return block;
+    }
+
+    size_t block_size;
+    std::vector<char *> blocks;
+    uintptr_t current = 0;
+    uintptr_t end = 0;
+    size_t used = 0;
+    size_t reserved = 0;
+};
+
+// 从 arena 分配的标准分配器，供 std::allocate_shared 使用：控制块和对象放在同一段连续内存里
+template<typename T>
+class arena_allocator {
+public:
+    using value_type = T;
+
+    explicit arena_allocator(arena *a) : pool(a) {}
+
+    template<typename U>
+    arena_allocator(const arena_allocator<U> &other) : pool(other.pool) {}
+
+    T *allocate(size_t n) {
+        return static_cast<T *>(pool->allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *, size_t) {}
+
+    template<typename U>
+    bool operator==(const arena_allocator<U> &other) const { return pool == other.pool; }
+
+    template<typename U>
+    bool operator!=(const arena_allocator<U> &other) const { return pool != other.pool; }
+
+public:
+    arena *pool;
+};
+
+// 当前的场景 arena，为空时退回普通的堆分配
+inline arena *&active_arena() {
+    static arena *current = nullptr;
+    return current;
+}
+
+// 在作用域内把 a 设为当前的场景 arena
+class arena_scope {
+public:
+    explicit arena_scope(arena *a) : previous(active_arena()) {
+        active_arena() = a;
+    }
+
+    arena_scope(const arena_scope &) = delete;
+
+    arena_scope &operator=(const arena_scope &) = delete;
+
+    ~arena_scope() {
+        active_arena() = previous;
+    }
+
+private:
+    arena *previous;
+};
+
+// 场景对象的 make_shared：有当前 arena 时从 arena 分配，否则与 std::make_shared 相同
+template<typename T, typename... Args>
+std::shared_ptr<T> arena_make_shared(Args &&... args) {
+    if (auto a = active_arena())
+        return std::allocate_shared<T>(arena_allocator<T>(a), std::forward<Args>(args)...);
+    return std::make_shared<T>(std::forward<Args>(args)...);
+}
+
+#endif //RAY_TRACING_ARENA_H
@@ -10,12 +10,12 @@ public:
             Point3 lookfrom,
             Point3 lookat,
             Vec3 vup,
-            double vfov,
-            double aspect_ratio,
-            double aperture,
-            double focus_dist,
-            double _time0 = 0,
-            double _time1 = 0) {
+            real vfov,
+            real aspect_ratio,
+            real aperture,
+            real focus_dist,
+            real _time0 = 0,
+            real _time1 = 0) {
         auto theta = degrees_to_radians(vfov);
         auto h = tan(theta / 2);
         auto viewport_height = 2.0 * h;
@@ -36,7 +36,7 @@ public:
         time1 = _time1;
     }
 
-    Ray get_ray(double x, double y) const {
+    Ray get_ray(real x, real y) const {
         Vec3 rd = lens_radius * random_in_unit_disk();
         Vec3 offset = u * rd.x() + v * rd.y();
 
@@ -52,8 +52,8 @@ private:
     Vec3 horizontal;
     Vec3 vertical;
     Vec3 u, v, w;
-    double lens_radius;
-    double time0, time1;    // 快门 开启/关闭 时间
+    real lens_radius;
+    real time0, time1;    // 快门 开启/关闭 时间
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,36 @@
+//
+// Process memory usage.
+//
+
+#ifndef RAY_TRACING_MEMORY_USAGE_H
+#define RAY_TRACING_MEMORY_USAGE_H
+
+#include <cstddef>
+
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+// 进程的峰值常驻内存 (字节)
+inline size_t peak_memory_bytes() {
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+        return 0;
+    return counters.PeakWorkingSetSize;
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+        return 0;
+#if defined(__APPLE__)
+    return static_cast<size_t>(usage.ru_maxrss);            // macOS 以字节为单位
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;     // Linux 以 KB 为单位
+#endif
+#endif
+}
+
+#endif //RAY_TRACING_MEMORY_USAGE_H
@@ -29,7 +29,7 @@ public:
         delete[] perm_z;
     }
 
-    double noise(const Point3 &p) const {
+    real noise(const Point3 &p) const {
 
 //        //
 //        auto i = static_cast<int>(4 * p.x()) & 255;
@@ -72,7 +72,7 @@ public:
         return perlin_interp(c, u, v, w);
     }
 
-    double turb(const Point3 &p, int depth = 7) const {
+    real turb(const Point3 &p, int depth = 7) const {
         auto accum = 0.0;
         auto temp_p = p;
         auto weight = 1.0;
@@ -117,7 +117,7 @@ private:
     }
 
     // 插值
-    static double perlin_interp(Vec3 c[2][2][2], double u, double v, double w) {
+    static real perlin_interp(Vec3 c[2][2][2], real u, real v, real w) {
         auto uu = u * u * (3 - 2 * u);
         auto vv = v * v * (3 - 2 * v);
         auto ww = w * w * (3 - 2 * w);
@@ -7,27 +7,35 @@ class Ray {
 public:
     Ray() = default;
 
-    Ray(const Point3 &origin, const Vec3 &direction, double time = 0.0) : orig(origin), dir(direction), tm(time) {}
+    Ray(const Point3 &origin, const Vec3 &direction, real time = 0.0) : orig(origin), dir(direction), tm(time) {
+        // 包围盒测试用的方向倒数和符号位，每条射线只算一次。分量为 0 时倒数为 ±inf
+        for (int a = 0; a < 3; a++) {
+            inv_dir[a] = 1 / dir[a];
+            sign[a] = inv_dir[a] < 0;
+        }
+    }
 
     Point3 origin() const { return orig; }
 
     Vec3 direction() const { return dir; }
 
-    double time() const { return tm; }
+    real time() const { return tm; }
 
     /// <summary>
     /// 交点
     /// </summary>
     /// <param name="t">距离</param>
     /// <returns>交点坐标</returns>
-    Point3 at(double t) const {
+    Point3 at(real t) const {
         return orig + t * dir;
     }
 
 public:
     Point3 orig;
     Vec3 dir;
-    double tm;  // 光线所在的时刻
+    real tm;  // 光线所在的时刻
+    Vec3 inv_dir;
+    int sign[3];    // 方向分量是否为负，决定每个轴上先进入包围盒的哪一侧
 };
 
 #endif
\ No newline at end of file
@@ -4,6 +4,10 @@
 #include <cmath>
 #include <limits>
 #include <memory>
+#include <algorithm>
+
+#include "../math/vec3.h"   // real
+#include "arena.h"
 
 // Usings
 
@@ -13,26 +17,33 @@ using std::sqrt;
 
 // Constants
 
-const double infinity = std::numeric_limits<double>::infinity();
-const double pi = 3.1415926535897932385;
+const real infinity = std::numeric_limits<real>::infinity();
+const real pi = 3.1415926535897932385;
+
+// 小于 1 的最大浮点数
+const real one_minus_epsilon = 1 - std::numeric_limits<real>::epsilon() / 2;
+
+// 射线起点偏移相对于交点坐标量级的比例，取代固定的 t_min = 0.001，单精度和双精度下都能避免自相交
+const real ray_offset_scale = 1024 * std::numeric_limits<real>::epsilon();
 
 // Utility Functions
 
-inline double degrees_to_radians(double degrees) {
+inline real degrees_to_radians(real degrees) {
     return degrees * pi / 180.0;
 }
 
-inline double random_double() {
+inline real random_double() {
     // Returns a random real in [0,1).
-    return rand() / (RAND_MAX + 1.0);
+    // 渲染时取当前样本生成器的下一维 (sampler.h)，否则是 rand()。单精度下可能被舍入为 1，钳制到 1 以下
+    return std::min(static_cast<real>(uniform_sample()), one_minus_epsilon);
 }
 
-inline double random_double(double min, double max) {
+inline real random_double(real min, real max) {
     // Returns a random real in [min,max).
     return min + (max - min) * random_double();
 }
 
-inline double clamp(double x, double min, double max) {
+inline real clamp(real x, real min, real max) {
     if (x < min) return min;
     if (x > max) return max;
     return x;
@@ -48,4 +59,17 @@ inline int random_int(int min, int max) {
 #include "ray.h"
 #include "../math/vec3.h"
 
+// Robustness
+
+// 点 p 附近的浮点误差尺度
+inline real surface_epsilon(const Point3 &p) {
+    return ray_offset_scale * (fmax(fmax(fabs(p.x()), fabs(p.y())), fabs(p.z())) + 1);
+}
+
+// 将交点沿法线推到出射方向 w 所在的一侧，作为新射线的起点
+inline Point3 offset_ray_origin(const Point3 &p, const Vec3 &n, const Vec3 &w) {
+    auto offset = surface_epsilon(p) * n;
+    return dot(w, n) < 0 ? p - offset : p + offset;
+}
+
 #endif
\ No newline at end of file
@@ -11,20 +11,37 @@
 
 #include <iostream>
 
+// 内置纹理的类型标签，用于 texture_value() 的封闭集合分发；自定义纹理为 custom，走虚函数。
+// 分发按标签直接调用内置类的函数，子类的覆盖会被跳过，所以内置纹理都是 final，自定义纹理从 texture 派生
+enum class texture_type : unsigned char {
+    custom,
+    solid_color,
+    checker,
+    noise,
+    image
+};
+
 class texture {
 public:
-    virtual Color value(double u, double v, const Point3 &p) const = 0;
+    texture(texture_type t = texture_type::custom) : type(t) {}
+
+    virtual Color value(real u, real v, const Point3 &p) const = 0;
+
+public:
+    texture_type type;
 };
 
-class solid_color : public texture {
+inline Color texture_value(const texture &tex, real u, real v, const Point3 &p);
+
+class solid_color final : public texture {
 public:
-    solid_color() = default;
+    solid_color() : texture(texture_type::solid_color) {}
 
-    solid_color(Color c) : color_value(c) {}
+    solid_color(Color c) : texture(texture_type::solid_color), color_value(c) {}
 
-    solid_color(double red, double green, double blue) : solid_color(Color(red, green, blue)) {}
+    solid_color(real red, real green, real blue) : solid_color(Color(red, green, blue)) {}
 
-    virtual Color value(double u, double v, const Vec3 &p) const override {
+    virtual Color value(real u, real v, const Vec3 &p) const override {
         return color_value;
     }
 
@@ -32,21 +49,23 @@ private:
     Color color_value;
 };
 
-class checker_texture : public texture {
+class checker_texture final : public texture {
 public:
-    checker_texture() {}
+    checker_texture() : texture(texture_type::checker) {}
 
-    checker_texture(Color c1, Color c2) : even(make_shared<solid_color>(c1)),
-                                          odd(make_shared<solid_color>(c2)) {}
+    checker_texture(Color c1, Color c2) : texture(texture_type::checker),
+                                          even(arena_make_shared<solid_color>(c1)),
+                                          odd(arena_make_shared<solid_color>(c2)) {}
 
-    checker_texture(shared_ptr<texture> _even, shared_ptr<texture> _odd) : even(_even), odd(_odd) {}
+    checker_texture(shared_ptr<texture> _even, shared_ptr<texture> _odd) : texture(texture_type::checker),
+                                                                           even(_even), odd(_odd) {}
 
-    virtual Color value(double u, double v, const Point3 &p) const override {
+    virtual Color value(real u, real v, const Point3 &p) const override {
         auto sines = sin(10 * p.x()) * sin(10 * p.y()) * sin(10 * p.z());
         if (sines < 0)
-            return odd->value(u, v, p);
+            return texture_value(*odd, u, v, p);
         else
-            return even->value(u, v, p);
+            return texture_value(*even, u, v, p);
     }
 
 public:
@@ -55,13 +74,13 @@ public:
 
 };
 
-class noise_texture : public texture {
+class noise_texture final : public texture {
 public:
-    noise_texture() {}
+    noise_texture() : texture(texture_type::noise) {}
 
-    noise_texture(double sc) : scale(sc) {}
+    noise_texture(real sc) : texture(texture_type::noise), scale(sc) {}
 
-    virtual Color value(double u, double v, const Point3 &p) const override {
+    virtual Color value(real u, real v, const Point3 &p) const override {
 //        return Color(1, 1, 1) * 0.5 * (1 + noise.noise(scale * p));
 //        return Color(1, 1, 1) * noise.turb(scale * p);
         return Color(1, 1, 1) * 0.5 * (1 + sin(scale * p.z() + 10 * noise.turb(scale * p)));
@@ -70,16 +89,16 @@ public:
 
 private:
     perlin noise;
-    double scale;
+    real scale;
 };
 
-class image_texture : public texture {
+class image_texture final : public texture {
 public:
     const static int bytes_per_pixel = 3;
 
-    image_texture() : data(nullptr), width(0), height(0), bytes_per_scanline(0) {}
+    image_texture() : texture(texture_type::image), data(nullptr), width(0), height(0), bytes_per_scanline(0) {}
 
-    image_texture(const char *filename) {
+    image_texture(const char *filename) : texture(texture_type::image) {
         auto components_per_pixel = bytes_per_pixel;
 
         data = stbi_load(filename, &width, &height, &components_per_pixel, components_per_pixel);
@@ -96,7 +115,7 @@ public:
         delete data;
     }
 
-    virtual Color value(double u, double v, const Vec3 &p) const override {
+    virtual Color value(real u, real v, const Vec3 &p) const override {
         // 如果没有纹理数据，返回青色
         if (data == nullptr)
             return Color(0, 1, 1);
@@ -124,4 +143,20 @@ private:
     int bytes_per_scanline;
 };
 
+// 内置纹理按标签 switch 后直接调用 (可内联)，自定义纹理退回虚函数
+inline Color texture_value(const texture &tex, real u, real v, const Point3 &p) {
+    switch (tex.type) {
+        case texture_type::solid_color:
+            return static_cast<const solid_color &>(tex).solid_color::value(u, v, p);
+        case texture_type::checker:
+            return static_cast<const checker_texture &>(tex).checker_texture::value(u, v, p);
+        case texture_type::noise:
+            return static_cast<const noise_texture &>(tex).noise_texture::value(u, v, p);
+        case texture_type::image:
+            return static_cast<const image_texture &>(tex).image_texture::value(u, v, p);
+        default:
+            return tex.value(u, v, p);
+    }
+}
+
 #endif //RAY_TRACING_TEXTURE_H
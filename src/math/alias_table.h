@@ -0,0 +1,80 @@
+//
+// Alias table: O(1) sampling of a discrete distribution given by non-negative weights.
+//
+
+#ifndef RAY_TRACING_ALIAS_TABLE_H
+#define RAY_TRACING_ALIAS_TABLE_H
+
+#include <cstdint>
+#include <vector>
+
+// Walker 的别名表 (Vose 的构造方法)：n 个桶，每个桶以概率 q 取自己、否则取 alias。
+// 一个 [0, 1) 内的随机数同时选桶 (整数部分) 和决定取哪一个 (小数部分)，采样与 n 无关
+class alias_table {
+public:
+    alias_table() = default;
+
+    // 权重全为 0 时退化为均匀分布
+    explicit alias_table(const std::vector<double> &weights) {
+        const auto n = weights.size();
+        bins.resize(n);
+        pmf.resize(n);
+        if (n == 0)
+            return;
+
+        double total = 0;
+        for (auto w: weights)
+            total += w;
+        for (size_t i = 0; i < n; i++)
+            pmf[i] = total > 0 ? weights[i] / total : 1.0 / n;
+
+        // 按 pmf * n 分成不足一个桶和超过一个桶的两组，每次用一个大的补满一个小的
+        std::vector<uint32_t> small, large;
+        std::vector<double> scaled(n);
+        for (size_t i = 0; i < n; i++) {
+            scaled[i] = pmf[i] * n;
+            (scaled[i] < 1 ? small : large).push_back(static_cast<uint32_t>(i));
+        }
+        while (!small.empty() && !large.empty()) {
+            auto s = small.back();
+            small.pop_back();
+            auto l = large.back();
+            bins[s] = {scaled[s], l};
+            scaled[l] -= 1 - scaled[s];
+            if (scaled[l] < 1) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        // 剩下的只差舍入误差，都当作正好一个桶
+        for (auto i: large)
+            bins[i] = {1, i};
+        for (auto i: small)
+            bins[i] = {1, i};
+    }
+
+    size_t size() const { return bins.size(); }
+
+    double probability(size_t i) const { return pmf[i]; }
+
+    // u 在 [0, 1) 内，表不能为空
+    size_t sample(double u) const {
+        const auto n = bins.size();
+        const auto x = u * n;
+        auto i = static_cast<size_t>(x);
+        if (i >= n)
+            i = n - 1;
+        return x - i < bins[i].q ? i : bins[i].alias;
+    }
+
+private:
+    struct bin {
+        double q;           // 取桶自己的概率
+        uint32_t alias;
+    };
+
+    std::vector<bin> bins;
+    std::vector<double> pmf;
+};
+
+#endif //RAY_TRACING_ALIAS_TABLE_H
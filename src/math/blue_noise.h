@@ -0,0 +1,48 @@
+//
+// Blue-noise sampler: one Owen-scrambled Sobol sequence shared by a tile of pixels in Z order.
+//
+
+#ifndef RAY_TRACING_BLUE_NOISE_H
+#define RAY_TRACING_BLUE_NOISE_H
+
+#include "sampler.h"
+
+// 蓝噪声采样 (Ahmed & Wonka 2020, "Screen-Space Blue-Noise Diffusion of Monte Carlo Sampling Error
+// via Hierarchical Ordering of Pixels")：64 x 64 的像素块共用一个 Owen 扰乱的 Sobol 序列，
+// 按 Z 序 (Morton 码) 给像素编号，第 k 个像素取序列中 [k * spp, (k + 1) * spp) 一段。
+// 对齐的 2^n x 2^n 像素块恰好是序列中对齐的一段，2 的幂个点在每一对维度上都是分层的，
+// 所以相邻像素的样本互相错开、误差相互抵消，低 spp 下误差集中在高频；每个像素内部仍是低差异序列。
+// 所有维度同样有效，不像阈值图平移那样只对前几维起作用。每个像素块用自己的种子，块之间没有重复的图案
+class blue_noise_sampler : public sobol_sampler {
+public:
+    // 像素编号是 start_pixel_sample 中的 j * image_width + i
+    blue_noise_sampler(int image_width, int samples_per_pixel) : width(static_cast<uint32_t>(image_width)) {
+        // 每个像素占用的一段按 2 的幂对齐，块内最多 4096 个像素，样本数不超过 2^20 时编号不会溢出
+        while (samples_stride < static_cast<uint32_t>(samples_per_pixel) && samples_stride < (1u << 20))
+            samples_stride <<= 1;
+    }
+
+    // 把 x, y 的低 bits 位交错成 Z 序编号
+    static uint32_t morton(uint32_t x, uint32_t y, int bits) {
+        uint32_t code = 0;
+        for (int b = 0; b < bits; b++)
+            code |= ((x >> b) & 1u) << (2 * b) | ((y >> b) & 1u) << (2 * b + 1);
+        return code;
+    }
+
+protected:
+    virtual uint32_t sample(uint32_t d) const override {
+        const auto x = pixel_index % width;
+        const auto y = pixel_index / width;
+        const auto tile_seed = hash_combine(x >> tile_bits, y >> tile_bits);
+        const auto index = morton(x, y, tile_bits) * samples_stride + sample_index % samples_stride;
+        return scrambled_sobol(tile_seed, index, d);
+    }
+
+private:
+    static const int tile_bits = 6;     // 64 x 64 的像素块
+    uint32_t width;
+    uint32_t samples_stride = 1;
+};
+
+#endif //RAY_TRACING_BLUE_NOISE_H
@@ -0,0 +1,214 @@
+//
+// Sample generators: Owen-scrambled Sobol and independent random samplers with per-dimension indexing.
+//
+
+#ifndef RAY_TRACING_SAMPLER_H
+#define RAY_TRACING_SAMPLER_H
+
+#include <cstdint>
+#include <cstdlib>
+
+// 一个像素样本 (一条相机路径) 依次消耗第 0, 1, 2, ... 维随机数，同一维在一个像素的所有样本中的取值组成一个序列。
+// 独立随机采样的每一维都是白噪声；低差异序列让每一维以及相邻的两维在样本之间分布均匀，收敛更快。
+// 调用者用 skip_to 把固定的用途 (像素偏移、镜头、光源上的点、材质方向 ...) 放在固定的维度上
+class sampler {
+public:
+    virtual ~sampler() {}
+
+    // 开始像素 pixel 的第 index 个样本，从第 0 维开始
+    void start_pixel_sample(uint32_t pixel, uint32_t index) {
+        pixel_index = pixel;
+        pixel_seed = hash(pixel);
+        sample_index = index;
+        dimension = 0;
+    }
+
+    // 跳到第 d 维。用过的维度不再使用：d 小于当前维度时不动，同一条路径上的随机数始终相互独立
+    void skip_to(uint32_t d) {
+        if (d > dimension)
+            dimension = d;
+    }
+
+    uint32_t current_dimension() const { return dimension; }
+
+    // 当前维度上 [0, 1) 内的样本，然后前进一维
+    double get_1d() {
+        return sample(dimension++) * (1.0 / 4294967296.0);
+    }
+
+    // murmur3 的 32 位终混函数
+    static uint32_t hash(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x85ebca6bu;
+        x ^= x >> 13;
+        x *= 0xc2b2ae35u;
+        x ^= x >> 16;
+        return x;
+    }
+
+    static uint32_t hash_combine(uint32_t seed, uint32_t v) {
+        return hash(seed ^ (v + 0x9e3779b9u + (seed << 6) + (seed >> 2)));
+    }
+
+protected:
+    // 当前样本第 d 维的 32 位定点数
+    virtual uint32_t sample(uint32_t d) const = 0;
+
+protected:
+    uint32_t pixel_index = 0;
+    uint32_t pixel_seed = 0;
+    uint32_t sample_index = 0;
+    uint32_t dimension = 0;
+};
+
+// 每一维独立的随机数，由 (像素, 样本, 维度) 哈希得到，用于和低差异序列对比
+class independent_sampler : public sampler {
+protected:
+    virtual uint32_t sample(uint32_t d) const override {
+        return hash_combine(hash_combine(pixel_seed, sample_index), d);
+    }
+};
+
+// Owen 扰乱的 Sobol 序列 (Burley 2020, "Practical Hash-based Owen Scrambling")。
+// 只用 Sobol 的前两维：第 2k 和 2k+1 维组成一对，每一对用自己的种子对样本编号做 Owen 扰乱 (打乱顺序)，
+// 再对两个分量做 Owen 扰乱。每一对都是 (0, 2) 序列，2 的幂个样本在二维上分层；不同的对之间没有相关性，
+// 所以维度数量不受方向数表的限制。种子还包含像素编号，相邻像素的误差互不相关
+class sobol_sampler : public sampler {
+public:
+    static uint32_t reverse_bits(uint32_t x) {
+        x = (x << 16) | (x >> 16);
+        x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+        x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+        x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+        x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+        return x;
+    }
+
+    // 对位反转后的数做 Laine-Karras 置换，相当于从高位到低位的嵌套随机置换 (Owen 扰乱)
+    static uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+        x = reverse_bits(x);
+        x += seed;
+        x ^= x * 0x6c50b47cu;
+        x ^= x * 0xb82f1e52u;
+        x ^= x * 0xc7afe638u;
+        x ^= x * 0x8d22f6e6u;
+        return reverse_bits(x);
+    }
+
+    // Sobol 序列第 0 维 (van der Corput) 和第 1 维 (本原多项式 x + 1) 的第 index 个数
+    static uint32_t sobol(uint32_t index, uint32_t component) {
+        if (component == 0)
+            return reverse_bits(index);
+        // 第 1 维是编号各位对应方向数的异或，按字节查表，每个样本 4 次查找
+        const auto &table = sobol_byte_table();
+        return table[0][index & 0xff] ^ table[1][(index >> 8) & 0xff]
+               ^ table[2][(index >> 16) & 0xff] ^ table[3][index >> 24];
+    }
+
+private:
+    struct byte_table {
+        uint32_t entries[4][256];
+
+        byte_table() {
+            // 方向数 v_0 = 2^31，v_k = v_{k-1} ^ (v_{k-1} >> 1)
+            uint32_t directions[32];
+            directions[0] = 1u << 31;
+            for (int k = 1; k < 32; k++)
+                directions[k] = directions[k - 1] ^ (directions[k - 1] >> 1);
+            for (int byte = 0; byte < 4; byte++) {
+                for (uint32_t value = 0; value < 256; value++) {
+                    uint32_t x = 0;
+                    for (int bit = 0; bit < 8; bit++) {
+                        if (value >> bit & 1)
+                            x ^= directions[byte * 8 + bit];
+                    }
+                    entries[byte][value] = x;
+                }
+            }
+        }
+
+        const uint32_t *operator[](int byte) const { return entries[byte]; }
+    };
+
+    static const byte_table &sobol_byte_table() {
+        static const byte_table table;
+        return table;
+    }
+
+protected:
+    virtual uint32_t sample(uint32_t d) const override {
+        return scrambled_sobol(pixel_seed, sample_index, d);
+    }
+
+    // 以 seed 扰乱的序列中第 index 个点的第 d 维
+    uint32_t scrambled_sobol(uint32_t seed, uint32_t index, uint32_t d) const {
+        // 一对维度的两个分量共用打乱后的编号，通常连续取用，缓存上一对
+        const auto pair = d >> 1;
+        if (pair != cached_pair || index != cached_sample || seed != cached_seed) {
+            cached_pair = pair;
+            cached_sample = index;
+            cached_seed = seed;
+            cached_pair_seed = hash_combine(seed, pair);
+            cached_index = nested_uniform_scramble(index, cached_pair_seed);
+        }
+        return nested_uniform_scramble(sobol(cached_index, d & 1), hash_combine(cached_pair_seed, d & 1));
+    }
+
+private:
+    mutable uint32_t cached_pair = ~0u;
+    mutable uint32_t cached_sample = 0;
+    mutable uint32_t cached_seed = 0;
+    mutable uint32_t cached_pair_seed = 0;
+    mutable uint32_t cached_index = 0;
+};
+
+// 当前的样本生成器，为空时退回 rand()
+inline sampler *&active_sampler() {
+    static sampler *current = nullptr;
+    return current;
+}
+
+// 在作用域内把 s 设为当前的样本生成器
+class sampler_scope {
+public:
+    explicit sampler_scope(sampler *s) : previous(active_sampler()) {
+        active_sampler() = s;
+    }
+
+    sampler_scope(const sampler_scope &) = delete;
+
+    sampler_scope &operator=(const sampler_scope &) = delete;
+
+    ~sampler_scope() {
+        active_sampler() = previous;
+    }
+
+private:
+    sampler *previous;
+};
+
+// [0, 1) 内的均匀样本：有当前样本生成器时取它的下一维，否则用 rand()
+inline double uniform_sample() {
+    if (auto s = active_sampler())
+        return s->get_1d();
+    return rand() / (RAND_MAX + 1.0);
+}
+
+// 跳到第 d 维，没有样本生成器时什么都不做
+inline void skip_to_dimension(uint32_t d) {
+    if (auto s = active_sampler())
+        s->skip_to(d);
+}
+
+// 从当前维度向上对齐到 size 的整数倍，开始新的一组维度并返回它的起点。
+// 每次弹射使用一组，前一次弹射用得多时整组后移，组内的相对布局不变
+inline uint32_t begin_dimension_block(uint32_t size) {
+    auto s = active_sampler();
+    if (!s)
+        return 0;
+    const auto start = (s->current_dimension() + size - 1) / size * size;
+    s->skip_to(start);
+    return start;
+}
+
+#endif //RAY_TRACING_SAMPLER_H
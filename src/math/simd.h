@@ -0,0 +1,183 @@
+//
+// Fixed-width float SIMD vector (floatn) for batched intersection of SoA primitive sets.
+//
+
+#ifndef RAY_TRACING_SIMD_H
+#define RAY_TRACING_SIMD_H
+
+#include <cmath>
+#include <cstdint>
+
+// SoA 批量求交使用的 float 向量，宽度与 real 无关：AVX 8 路，SSE / NEON 4 路，没有指令集时标量 4 路。
+// 比较运算返回掩码，movemask 把掩码压成整数的低 width 位。
+#if defined(__AVX__)
+    #define RT_SIMD_FLOATN_AVX
+    #include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+    #define RT_SIMD_FLOATN_SSE
+    #include <xmmintrin.h>
+    #if defined(__SSE2__) || defined(_M_X64)
+        #include <emmintrin.h>
+    #endif
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    #define RT_SIMD_FLOATN_NEON
+    #include <arm_neon.h>
+#endif
+
+struct floatn {
+#if defined(RT_SIMD_FLOATN_AVX)
+    enum { width = 8 };
+    __m256 v;
+#elif defined(RT_SIMD_FLOATN_SSE)
+    enum { width = 4 };
+    __m128 v;
+#elif defined(RT_SIMD_FLOATN_NEON)
+    enum { width = 4 };
+    float32x4_t v;
+#else
+    enum { width = 4 };
+    float v[4];     // 掩码用 0 / 1 表示
+#endif
+
+    static floatn load(const float *p) {
+        floatn r;
+#if defined(RT_SIMD_FLOATN_AVX)
+        r.v = _mm256_loadu_ps(p);
+#elif defined(RT_SIMD_FLOATN_SSE)
+        r.v = _mm_loadu_ps(p);
+#elif defined(RT_SIMD_FLOATN_NEON)
+        r.v = vld1q_f32(p);
+#else
+        for (int i = 0; i < 4; i++) r.v[i] = p[i];
+#endif
+        return r;
+    }
+
+    // 读取 width 个 uint16 并转换为 float (量化数据解码)
+    static floatn load_u16(const uint16_t *p) {
+        floatn r;
+#if defined(RT_SIMD_FLOATN_AVX)
+        auto q = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+        auto lo = _mm_cvtepi32_ps(_mm_unpacklo_epi16(q, _mm_setzero_si128()));
+        auto hi = _mm_cvtepi32_ps(_mm_unpackhi_epi16(q, _mm_setzero_si128()));
+        r.v = _mm256_insertf128_ps(_mm256_castps128_ps256(lo), hi, 1);
+#elif defined(RT_SIMD_FLOATN_SSE) && (defined(__SSE2__) || defined(_M_X64))
+        auto q = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p));
+        r.v = _mm_cvtepi32_ps(_mm_unpacklo_epi16(q, _mm_setzero_si128()));
+#elif defined(RT_SIMD_FLOATN_SSE)
+        r.v = _mm_set_ps(p[3], p[2], p[1], p[0]);
+#elif defined(RT_SIMD_FLOATN_NEON)
+        r.v = vcvtq_f32_u32(vmovl_u16(vld1_u16(p)));
+#else
+        for (int i = 0; i < 4; i++) r.v[i] = p[i];
+#endif
+        return r;
+    }
+
+    static floatn splat(float s) {
+        floatn r;
+#if defined(RT_SIMD_FLOATN_AVX)
+        r.v = _mm256_set1_ps(s);
+#elif defined(RT_SIMD_FLOATN_SSE)
+        r.v = _mm_set1_ps(s);
+#elif defined(RT_SIMD_FLOATN_NEON)
+        r.v = vdupq_n_f32(s);
+#else
+        for (int i = 0; i < 4; i++) r.v[i] = s;
+#endif
+        return r;
+    }
+};
+
+#if defined(RT_SIMD_FLOATN_AVX)
+#define RT_SIMD_FLOATN_OP(op, expr) \
+    inline floatn operator op(const floatn &a, const floatn &b) { floatn r; r.v = expr; return r; }
+RT_SIMD_FLOATN_OP(+, _mm256_add_ps(a.v, b.v))
+RT_SIMD_FLOATN_OP(-, _mm256_sub_ps(a.v, b.v))
+RT_SIMD_FLOATN_OP(*, _mm256_mul_ps(a.v, b.v))
+RT_SIMD_FLOATN_OP(&, _mm256_and_ps(a.v, b.v))
+RT_SIMD_FLOATN_OP(|, _mm256_or_ps(a.v, b.v))
+RT_SIMD_FLOATN_OP(<=, _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ))
+RT_SIMD_FLOATN_OP(>=, _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ))
+#elif defined(RT_SIMD_FLOATN_SSE)
+#define RT_SIMD_FLOATN_OP(op, expr) \
+    inline floatn operator op(const floatn &a, const floatn &b) { floatn r; r.v = expr; return r; }
+RT_SIMD_FLOATN_OP(+, _mm_add_ps(a.v, b.v))
+RT_SIMD_FLOATN_OP(-, _mm_sub_ps(a.v, b.v))
+RT_SIMD_FLOATN_OP(*, _mm_mul_ps(a.v, b.v))
+RT_SIMD_FLOATN_OP(&, _mm_and_ps(a.v, b.v))
+RT_SIMD_FLOATN_OP(|, _mm_or_ps(a.v, b.v))
+RT_SIMD_FLOATN_OP(<=, _mm_cmple_ps(a.v, b.v))
+RT_SIMD_FLOATN_OP(>=, _mm_cmpge_ps(a.v, b.v))
+#elif defined(RT_SIMD_FLOATN_NEON)
+#define RT_SIMD_FLOATN_OP(op, expr) \
+    inline floatn operator op(const floatn &a, const floatn &b) { floatn r; r.v = expr; return r; }
+RT_SIMD_FLOATN_OP(+, vaddq_f32(a.v, b.v))
+RT_SIMD_FLOATN_OP(-, vsubq_f32(a.v, b.v))
+RT_SIMD_FLOATN_OP(*, vmulq_f32(a.v, b.v))
+RT_SIMD_FLOATN_OP(&, vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))))
+RT_SIMD_FLOATN_OP(|, vreinterpretq_f32_u32(vorrq_u32(vreinterpretq_u32_f32(a.v), vreinterpretq_u32_f32(b.v))))
+RT_SIMD_FLOATN_OP(<=, vreinterpretq_f32_u32(vcleq_f32(a.v, b.v)))
+RT_SIMD_FLOATN_OP(>=, vreinterpretq_f32_u32(vcgeq_f32(a.v, b.v)))
+#else
+#define RT_SIMD_FLOATN_OP(op, expr) \
+    inline floatn operator op(const floatn &a, const floatn &b) { \
+        floatn r; for (int i = 0; i < 4; i++) r.v[i] = expr; return r; }
+RT_SIMD_FLOATN_OP(+, a.v[i] + b.v[i])
+RT_SIMD_FLOATN_OP(-, a.v[i] - b.v[i])
+RT_SIMD_FLOATN_OP(*, a.v[i] * b.v[i])
+RT_SIMD_FLOATN_OP(&, (a.v[i] != 0 && b.v[i] != 0) ? 1.0f : 0.0f)
+RT_SIMD_FLOATN_OP(|, (a.v[i] != 0 || b.v[i] != 0) ? 1.0f : 0.0f)
+RT_SIMD_FLOATN_OP(<=, a.v[i] <= b.v[i] ? 1.0f : 0.0f)
+RT_SIMD_FLOATN_OP(>=, a.v[i] >= b.v[i] ? 1.0f : 0.0f)
+#endif
+#undef RT_SIMD_FLOATN_OP
+
+// 逐分量 sqrt(max(x, 0))
+inline floatn sqrt_clamped(const floatn &x) {
+    floatn r;
+#if defined(RT_SIMD_FLOATN_AVX)
+    r.v = _mm256_sqrt_ps(_mm256_max_ps(x.v, _mm256_setzero_ps()));
+#elif defined(RT_SIMD_FLOATN_SSE)
+    r.v = _mm_sqrt_ps(_mm_max_ps(x.v, _mm_setzero_ps()));
+#elif defined(RT_SIMD_FLOATN_NEON)
+    r.v = vsqrtq_f32(vmaxq_f32(x.v, vdupq_n_f32(0)));
+#else
+    for (int i = 0; i < 4; i++) r.v[i] = std::sqrt(x.v[i] > 0 ? x.v[i] : 0.0f);
+#endif
+    return r;
+}
+
+// 逐分量绝对值
+inline floatn abs(const floatn &x) {
+    floatn r;
+#if defined(RT_SIMD_FLOATN_AVX)
+    r.v = _mm256_andnot_ps(_mm256_set1_ps(-0.0f), x.v);
+#elif defined(RT_SIMD_FLOATN_SSE)
+    r.v = _mm_andnot_ps(_mm_set1_ps(-0.0f), x.v);
+#elif defined(RT_SIMD_FLOATN_NEON)
+    r.v = vabsq_f32(x.v);
+#else
+    for (int i = 0; i < 4; i++) r.v[i] = std::fabs(x.v[i]);
+#endif
+    return r;
+}
+
+// 掩码中为真的通道对应的位
+inline int movemask(const floatn &mask) {
+#if defined(RT_SIMD_FLOATN_AVX)
+    return _mm256_movemask_ps(mask.v);
+#elif defined(RT_SIMD_FLOATN_SSE)
+    return _mm_movemask_ps(mask.v);
+#elif defined(RT_SIMD_FLOATN_NEON)
+    static const int32_t bit_values[4] = {1, 2, 4, 8};
+    uint32x4_t bits = vandq_u32(vreinterpretq_u32_f32(mask.v), vreinterpretq_u32_s32(vld1q_s32(bit_values)));
+    return static_cast<int>(vaddvq_u32(bits));
+#else
+    int bits = 0;
+    for (int i = 0; i < 4; i++) bits |= (mask.v[i] != 0) << i;
+    return bits;
+#endif
+}
+
+#endif //RAY_TRACING_SIMD_H
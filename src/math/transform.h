@@ -0,0 +1,144 @@
+//
+// 3x4 affine transform: rotation, scale and translation in one matrix.
+//
+
+#ifndef RAY_TRACING_TRANSFORM_H
+#define RAY_TRACING_TRANSFORM_H
+
+#include "vec3.h"
+
+#include <cmath>
+
+// 仿射变换 p' = A p + b，按行存放为 3x4 矩阵 m = [A | b]。
+// 多层变换用 operator* 合成为一个矩阵，求交时只做一次点、向量变换。
+class transform {
+public:
+    // 单位变换
+    transform() {
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 4; j++)
+                m[i][j] = i == j ? 1 : 0;
+    }
+
+    static transform translation(const Vec3 &offset) {
+        transform t;
+        for (int i = 0; i < 3; i++)
+            t.m[i][3] = offset[i];
+        return t;
+    }
+
+    static transform scaling(const Vec3 &s) {
+        transform t;
+        for (int i = 0; i < 3; i++)
+            t.m[i][i] = s[i];
+        return t;
+    }
+
+    // 绕 y 轴旋转，与原来的 rotate_y 方向一致：x' = cos x + sin z，z' = -sin x + cos z
+    static transform rotation_y(real degrees) {
+        auto radians = degrees * 3.1415926535897932385 / 180;
+        auto s = static_cast<real>(std::sin(radians));
+        auto c = static_cast<real>(std::cos(radians));
+        transform t;
+        t.m[0][0] = c;
+        t.m[0][2] = s;
+        t.m[2][0] = -s;
+        t.m[2][2] = c;
+        return t;
+    }
+
+    // 绕任意轴旋转 (右手定则，Rodrigues 公式)
+    static transform rotation(const Vec3 &axis, real degrees) {
+        auto radians = degrees * 3.1415926535897932385 / 180;
+        auto s = static_cast<real>(std::sin(radians));
+        auto c = static_cast<real>(std::cos(radians));
+        auto a = unit_vector(axis);
+        transform t;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++)
+                t.m[i][j] = a[i] * a[j] * (1 - c) + (i == j ? c : 0);
+        }
+        t.m[0][1] -= a[2] * s;
+        t.m[0][2] += a[1] * s;
+        t.m[1][0] += a[2] * s;
+        t.m[1][2] -= a[0] * s;
+        t.m[2][0] -= a[1] * s;
+        t.m[2][1] += a[0] * s;
+        return t;
+    }
+
+    Point3 point(const Point3 &p) const {
+        return Point3(m[0][0] * p[0] + m[0][1] * p[1] + m[0][2] * p[2] + m[0][3],
+                      m[1][0] * p[0] + m[1][1] * p[1] + m[1][2] * p[2] + m[1][3],
+                      m[2][0] * p[0] + m[2][1] * p[1] + m[2][2] * p[2] + m[2][3]);
+    }
+
+    // 方向只受线性部分影响
+    Vec3 vector(const Vec3 &v) const {
+        return Vec3(m[0][0] * v[0] + m[0][1] * v[1] + m[0][2] * v[2],
+                    m[1][0] * v[0] + m[1][1] * v[1] + m[1][2] * v[2],
+                    m[2][0] * v[0] + m[2][1] * v[1] + m[2][2] * v[2]);
+    }
+
+    // 用线性部分的转置变换。在逆变换上调用即为法线的变换 (A^-1)^T n，结果不再是单位向量
+    Vec3 transposed_vector(const Vec3 &v) const {
+        return Vec3(m[0][0] * v[0] + m[1][0] * v[1] + m[2][0] * v[2],
+                    m[0][1] * v[0] + m[1][1] * v[1] + m[2][1] * v[2],
+                    m[0][2] * v[0] + m[1][2] * v[1] + m[2][2] * v[2]);
+    }
+
+    // 线性部分第 i 行的长度：半径为 r 的球变换后，包围盒在轴 i 上的半宽为 r * row_length(i)
+    real row_length(int i) const {
+        return std::sqrt(m[i][0] * m[i][0] + m[i][1] * m[i][1] + m[i][2] * m[i][2]);
+    }
+
+    // 线性部分是否为单位矩阵，即只有平移
+    bool is_translation() const {
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                if (m[i][j] != (i == j ? 1 : 0))
+                    return false;
+        return true;
+    }
+
+    // 伴随矩阵求逆，调用者保证矩阵可逆 (缩放分量不为 0)
+    transform inverse() const {
+        transform t;
+        const auto det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+                         - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+                         + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+        const auto inv_det = 1 / det;
+
+        t.m[0][0] = (m[1][1] * m[2][2] - m[1][2] * m[2][1]) * inv_det;
+        t.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inv_det;
+        t.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv_det;
+        t.m[1][0] = (m[1][2] * m[2][0] - m[1][0] * m[2][2]) * inv_det;
+        t.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv_det;
+        t.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inv_det;
+        t.m[2][0] = (m[1][0] * m[2][1] - m[1][1] * m[2][0]) * inv_det;
+        t.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inv_det;
+        t.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv_det;
+
+        // 平移部分：-A^-1 b
+        for (int i = 0; i < 3; i++)
+            t.m[i][3] = -(t.m[i][0] * m[0][3] + t.m[i][1] * m[1][3] + t.m[i][2] * m[2][3]);
+        return t;
+    }
+
+public:
+    real m[3][4];
+};
+
+// 合成变换：(a * b)(p) = a(b(p))，先做 b 再做 a
+inline transform operator*(const transform &a, const transform &b) {
+    transform t;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            t.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j];
+        }
+        t.m[i][3] += a.m[i][3];
+    }
+    return t;
+}
+
+#endif //RAY_TRACING_TRANSFORM_H
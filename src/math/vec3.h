@@ -8,19 +8,29 @@
 using std::sqrt;
 using std::fabs;
 
+// 标量类型，默认双精度；定义 RT_USE_FLOAT 后整个渲染器以单精度运行
+#ifdef RT_USE_FLOAT
+using real = float;
+#else
+using real = double;
+#endif
+
+// 渲染时的随机数来自当前的样本生成器
+#include "sampler.h"
+
 class Vec3 
 {
 public:
 	Vec3() : e{0,0,0} {}
-	Vec3(double e0, double e1, double e2) : e{e0, e1, e2} {}
+	Vec3(real e0, real e1, real e2) : e{e0, e1, e2} {}
 
-	double x() const { return e[0]; }
-	double y() const { return e[1]; }
-	double z() const { return e[2]; }
+	real x() const { return e[0]; }
+	real y() const { return e[1]; }
+	real z() const { return e[2]; }
 
 	Vec3 operator-() const { return Vec3(-e[0], -e[1], -e[2]); }
-	double operator[](int i) const { return e[i]; }
-	double& operator[](int i) { return e[i]; }
+	real operator[](int i) const { return e[i]; }
+	real& operator[](int i) { return e[i]; }
 
 	Vec3& operator+=(const Vec3& v) 
 	{
@@ -30,7 +40,7 @@ public:
 		return *this;
 	}
 
-	Vec3& operator*=(const double t) 
+	Vec3& operator*=(const real t) 
 	{
 		e[0] *= t;
 		e[1] *= t;
@@ -38,17 +48,17 @@ public:
 		return *this;
 	}
 
-	Vec3& operator/=(const double t) 
+	Vec3& operator/=(const real t) 
 	{
 		return *this *= 1 / t;
 	}
 
-	double length() const 
+	real length() const 
 	{
 		return sqrt(length_squared());
 	}
 
-	double length_squared() const
+	real length_squared() const
 	{
 		return e[0] * e[0] + e[1] * e[1] + e[2] * e[2];
 	}
@@ -63,21 +73,21 @@ public:
 	inline static Vec3 random()
 	{
 		return Vec3(
-			rand() / (RAND_MAX + 1.0),
-			rand() / (RAND_MAX + 1.0), 
-			rand() / (RAND_MAX + 1.0));
+			uniform_sample(),
+			uniform_sample(),
+			uniform_sample());
 	}
 
-	inline static Vec3 random(double min, double max)
+	inline static Vec3 random(real min, real max)
 	{
 		return Vec3(
-			min + (max - min) * rand() / (RAND_MAX + 1.0),
-			min + (max - min) * rand() / (RAND_MAX + 1.0),
-			min + (max - min) * rand() / (RAND_MAX + 1.0));
+			min + (max - min) * uniform_sample(),
+			min + (max - min) * uniform_sample(),
+			min + (max - min) * uniform_sample());
 	}
 	
 public:
-	double e[3];
+	real e[3];
 
 };
 
@@ -108,22 +118,22 @@ inline Vec3 operator*(const Vec3& u, const Vec3& v)
 	return Vec3(u.e[0] * v.e[0], u.e[1] * v.e[1], u.e[2] * v.e[2]);
 }
 
-inline Vec3 operator*(double t, const Vec3& v) 
+inline Vec3 operator*(real t, const Vec3& v) 
 {
 	return Vec3(t * v.e[0], t * v.e[1], t * v.e[2]);
 }
 
-inline Vec3 operator*(const Vec3& v, double t) 
+inline Vec3 operator*(const Vec3& v, real t) 
 {
 	return t * v;
 }
 
-inline Vec3 operator/(Vec3 v, double t) 
+inline Vec3 operator/(Vec3 v, real t) 
 {
 	return (1 / t) * v;
 }
 
-inline double dot(const Vec3& u, const Vec3& v)
+inline real dot(const Vec3& u, const Vec3& v)
 {
 	return u.e[0] * v.e[0]
 		+ u.e[1] * v.e[1]
@@ -143,32 +153,28 @@ inline Vec3 unit_vector(Vec3 v)
 	return v / v.length();
 }
 
+// 以下采样函数都是从 [0, 1) 样本的直接映射，不用拒绝采样：每个方向固定消耗 2 (球内的点 3) 维样本，
+// 低差异序列的分层才能传到方向上
+
 inline Vec3 random_in_unit_disk()
 {
-    while (true)
-    {
-        auto p = Vec3(
-                rand() / (RAND_MAX + 1.0),
-                rand() / (RAND_MAX + 1.0),
-                0);
-        if (p.length_squared() >= 1) continue;
-        return p;
-    }
+    auto r = sqrt(uniform_sample());
+    auto phi = 2 * 3.1415926535897932385 * uniform_sample();
+    return Vec3(r * cos(phi), r * sin(phi), 0);
 }
 
-inline Vec3 random_in_unit_sphere() 
+inline Vec3 random_unit_vector() 
 {
-	while (true) 
-	{
-		auto p = Vec3::random(-1, 1);
-		if (p.length_squared() >= 1) continue;
-		return p;
-	}
+	auto z = 1 - 2 * uniform_sample();
+	auto phi = 2 * 3.1415926535897932385 * uniform_sample();
+	auto r = sqrt(fmax(0.0, 1 - z * z));
+	return Vec3(r * cos(phi), r * sin(phi), z);
 }
 
-inline Vec3 random_unit_vector() 
+inline Vec3 random_in_unit_sphere() 
 {
-	return unit_vector(random_in_unit_sphere());
+	auto direction = random_unit_vector();
+	return std::cbrt(uniform_sample()) * direction;
 }
 
 inline Vec3 random_in_hemisphere(const Vec3& normal)
@@ -191,7 +197,7 @@ inline Vec3 reflect(const Vec3& v, const Vec3& n)
 	return v - 2 * dot(v, n) * n;
 }
 
-inline Vec3 refract(const Vec3& uv, const Vec3& n, double etai_over_etat)
+inline Vec3 refract(const Vec3& uv, const Vec3& n, real etai_over_etat)
 {
 	auto cos_theta = fmin(dot(-uv, n), 1.0);
 	Vec3 r_out_perp = etai_over_etat * (uv + cos_theta * n);
@@ -201,8 +207,8 @@ inline Vec3 refract(const Vec3& uv, const Vec3& n, double etai_over_etat)
 
 inline Vec3 random_cosine_direction()
 {
-    auto r1 = rand() / (RAND_MAX + 1.0);
-    auto r2 = rand() / (RAND_MAX + 1.0);
+    auto r1 = uniform_sample();
+    auto r2 = uniform_sample();
     auto z = sqrt(1 - r2);
 
     auto phi = 2 * 3.1415926535897932385 * r1;
@@ -212,10 +218,10 @@ inline Vec3 random_cosine_direction()
     return Vec3(x, y, z);
 }
 
-inline Vec3 random_to_sphere(double radius, double distance_squared)
+inline Vec3 random_to_sphere(real radius, real distance_squared)
 {
-    auto r1 = rand() / (RAND_MAX + 1.0);
-    auto r2 = rand() / (RAND_MAX + 1.0);
+    auto r1 = uniform_sample();
+    auto r2 = uniform_sample();
     auto z = 1 + r2 * (sqrt(1 - radius * radius / distance_squared) - 1);
 
     auto phi = 2 * 3.1415926535897932385 * r1;